@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Host build of the library: the pixel buffer of Adafruit_NeoPixel, show()
+// sends nothing. Same type constants and gamma table as the library.
+
+#ifndef ADAFRUIT_NEOPIXEL_H
+#define ADAFRUIT_NEOPIXEL_H
+
+#include <Arduino.h>
+
+#define NEO_RGB  ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRB  ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_RGBW ((3 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRBW ((3 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+typedef uint16_t neoPixelType;
+
+class Adafruit_NeoPixel {
+  public:
+    Adafruit_NeoPixel(uint16_t n, int16_t p = 6, neoPixelType t = NEO_GRB + NEO_KHZ800)
+    : numLEDs(n),
+      numBytes(n * ((((t >> 6) & 3) == ((t >> 4) & 3)) ? 3 : 4)),
+      pin(p),
+      pixels(static_cast<uint8_t*>(calloc(numBytes, 1)))
+    {
+    }
+    ~Adafruit_NeoPixel() { free(pixels); }
+
+    void begin() { begun = true; }
+    void show() {}
+    void clear() { memset(pixels, 0, numBytes); }
+    bool canShow() const { return true; }
+    int16_t getPin() const { return pin; }
+    uint16_t numPixels() const { return numLEDs; }
+    uint8_t* getPixels() const { return pixels; }
+
+    // (i / 255) ^ 2.6, rounded: the table of the library
+    static uint8_t gamma8(uint8_t x) { return uint8_t(pow(x / 255.0, 2.6) * 255.0 + 0.5); }
+
+  protected:
+    bool begun = false;
+    uint16_t numLEDs;
+    uint16_t numBytes;
+    int16_t pin;
+    uint8_t* pixels;
+
+  private:
+    Adafruit_NeoPixel(const Adafruit_NeoPixel&);
+    Adafruit_NeoPixel& operator=(const Adafruit_NeoPixel&);
+};
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Host build of the library: the PCA9685 driver calls, writing to the
+// device-less host Wire.
+
+#ifndef _ADAFRUIT_PWMServoDriver_H
+#define _ADAFRUIT_PWMServoDriver_H
+
+#include <Wire.h>
+
+class Adafruit_PWMServoDriver {
+  public:
+    Adafruit_PWMServoDriver(uint8_t address = 0x40, TwoWire& i2c = Wire) : address_(address), i2c_(i2c) {}
+
+    bool begin(uint8_t /*prescale*/ = 0) { return true; }
+    void setOscillatorFrequency(uint32_t /*frequency*/) {}
+    void setPWMFreq(float /*frequency*/) {}
+    void writeMicroseconds(uint8_t num, uint16_t microseconds)
+    {
+      i2c_.beginTransmission(address_);
+      i2c_.write(0x06 + 4 * num); // LED0_ON_L
+      i2c_.write(microseconds);
+      i2c_.write(microseconds >> 8);
+      i2c_.endTransmission();
+    }
+
+  private:
+    uint8_t address_;
+    TwoWire& i2c_;
+};
+
+#endif
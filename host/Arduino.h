@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Host build of the library: the subset of the Arduino core it uses, for
+// the programs of tools/. Not a board emulation: pins read low and pulses
+// never come, there are no interrupts or serial input.
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM
+#define INPUT 0
+#define OUTPUT 1
+#define LOW 0
+#define HIGH 1
+#define A0 14
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+unsigned long millis();
+unsigned long micros();
+inline void delay(unsigned long /*ms*/) {}
+inline void delayMicroseconds(unsigned int /*us*/) {}
+inline void yield() {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+inline void pinMode(uint8_t /*pin*/, uint8_t /*mode*/) {}
+inline void digitalWrite(uint8_t /*pin*/, uint8_t /*value*/) {}
+inline int digitalRead(uint8_t /*pin*/) { return LOW; }
+inline int analogRead(uint8_t /*pin*/) { return 0; }
+inline unsigned long pulseIn(uint8_t /*pin*/, uint8_t /*state*/, unsigned long /*timeout*/) { return 0; }
+
+//-----------------------------------------------------------------------------
+// Byte streams, as FrameRecorder and FrameComparer use them.
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t data) = 0;
+    virtual size_t write(const uint8_t* data, size_t size)
+    {
+      size_t i = 0;
+      while (i < size && write(data[i]) == 1) {
+        ++i;
+      }
+      return i;
+    }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0; // -1 at the end
+    virtual int peek() = 0;
+
+    size_t readBytes(char* data, size_t size) // no timeout: the data is there or never comes
+    {
+      size_t i = 0;
+      for (int c = 0; i < size && (c = read()) >= 0; ++i) {
+        data[i] = char(c);
+      }
+      return i;
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Serial, to stderr: library messages stay out of the tool output.
+class HardwareSerial {
+  public:
+    void begin(unsigned long /*baud*/) {}
+    void print(const char* str) { fputs(str, stderr); }
+    void print(const __FlashStringHelper* str) { print(reinterpret_cast<const char*>(str)); }
+    void print(unsigned long val) { fprintf(stderr, "%lu", val); }
+    void print(long val) { fprintf(stderr, "%ld", val); }
+    void print(unsigned int val) { fprintf(stderr, "%u", val); }
+    void print(int val) { fprintf(stderr, "%d", val); }
+    void print(double val) { fprintf(stderr, "%.2f", val); }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Host build of the library: the fixed capacity vector of the Array
+// library, the members the library uses.
+
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <stddef.h>
+
+template <typename T, size_t MAX_SIZE>
+class Array {
+  public:
+    T& operator[](size_t i) { return values_[i]; }
+    const T& operator[](size_t i) const { return values_[i]; }
+    void clear() { size_ = 0; }
+    void push_back(const T& value) { if (size_ < MAX_SIZE) { values_[size_++] = value; } }
+    void remove(size_t index) {
+      if (index < size_) {
+        for (size_t i = index + 1; i < size_; ++i) {
+          values_[i - 1] = values_[i];
+        }
+        --size_;
+      }
+    }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == MAX_SIZE; }
+
+  private:
+    T values_[MAX_SIZE];
+    size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Host build of the library: a file of the host as a Stream, where a
+// sketch would use a file of the SD card.
+
+#ifndef HOST_FILE_H
+#define HOST_FILE_H
+
+#include <Arduino.h>
+
+class HostFile : public Stream {
+  public:
+    HostFile() {}
+    ~HostFile() { close(); }
+
+    bool open(const char* filename, const char* mode) // as fopen()
+    {
+      close();
+      file_ = fopen(filename, mode);
+      return (file_ != nullptr);
+    }
+
+    void close()
+    {
+      if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+      }
+    }
+
+    explicit operator bool() const { return file_ != nullptr; }
+
+    virtual size_t write(uint8_t data) { return fwrite(&data, 1, 1, file_); }
+    virtual size_t write(const uint8_t* data, size_t size) { return fwrite(data, 1, size, file_); }
+    virtual int available() { return (peek() >= 0) ? 1 : 0; }
+    virtual int read() { return fgetc(file_); }
+    virtual int peek()
+    {
+      const int c = fgetc(file_);
+      if (c >= 0) {
+        ungetc(c, file_);
+      }
+      return c;
+    }
+
+  private:
+    FILE* file_ = nullptr;
+
+    HostFile(const HostFile&);
+    HostFile& operator=(const HostFile&);
+};
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Scenarios of the golden frame check, shared by the sketch (files on the SD
+// card) and tools/nico_golden_frames (files of the host).
+
+#ifndef GOLDEN_SCENARIOS_H
+#define GOLDEN_SCENARIOS_H
+
+#include <nico_frame.h>
+
+#define GOLDEN_PIXEL_PIN 6
+#define GOLDEN_NUM_PIXELS 60
+#define GOLDEN_NUM_FRAMES 500
+#define GOLDEN_FRAME_PERIOD 10 // ms
+#define GOLDEN_SEED 1234
+
+//-----------------------------------------------------------------------------
+static void setupSnake(NeoPixelArray& array)
+{
+  array.add(SnakeSetup { Color(255, 0, 128), 0, CW, 10, 1.0, 30 });
+  array.add(SnakeSetup { Color(0, 200, 40), 30, CCW, 20, 0.5, 70 });
+}
+
+static void setupPulse(NeoPixelArray& array)
+{
+  array.add(PulseSetup { Color(40, 40, 0), 170 });
+}
+
+static void setupRandom(NeoPixelArray& array)
+{
+  array.add(RandomSetup { Color(200, 200, 200), Color(0, 0, 10), 8, 40 });
+}
+
+static void setupMixed(NeoPixelArray& array)
+{
+  setupSnake(array);
+  array.add(SnakeSetup { Color(200, 200, 0), 15, CW, 60, 2.0, 20 });
+  array.add(PulseSetup { Color(100, 0, 0), 230 });
+}
+
+struct Scenario {
+  const char* name_;
+  const char* filename_;
+  void (*setup_)(NeoPixelArray& array);
+};
+
+static const Scenario scenarios[] = {
+  { "snake", "GSNAKE.BIN", setupSnake },
+  { "pulse", "GPULSE.BIN", setupPulse },
+  { "random", "GRANDOM.BIN", setupRandom },
+  { "mixed", "GMIXED.BIN", setupMixed },
+};
+
+//-----------------------------------------------------------------------------
+// Renders the frames of the scenario into recorder, or compares them with
+// comparer. False if the golden file does not match the array.
+static bool renderScenario(const Scenario& scenario, FrameRecorder* recorder, FrameComparer* comparer)
+{
+  Clock::simulate(0);
+  Prng::seed(GOLDEN_SEED);
+
+  NeoPixelArray array(GOLDEN_NUM_PIXELS, GOLDEN_PIXEL_PIN, NEO_GRB, DebugMode::DryRun);
+  array.init();
+  scenario.setup_(array);
+  array.setFramePeriod(0); // a frame at every step
+
+  if (recorder != nullptr) {
+    recorder->begin(array);
+  } else if (not comparer->begin(array)) {
+    Clock::release();
+    return false;
+  }
+
+  for (size_t i = 0; i < GOLDEN_NUM_FRAMES; ++i) {
+    Clock::advance(GOLDEN_FRAME_PERIOD);
+    array.update();
+    if (recorder != nullptr) {
+      recorder->record(array);
+    } else {
+      comparer->compare(array);
+    }
+  }
+  Clock::release();
+  return true;
+}
+
+#endif
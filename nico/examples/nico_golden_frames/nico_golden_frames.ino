@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Golden frame regression check of the NeoPixel effects.
+//
+// Effects run under a simulated clock with a seeded random generator, so
+// the frames are the same on every run. With GOLDEN_RECORD set to 1 each
+// scenario is captured to a file on the SD card; with 0 the frames are
+// compared against these files, with GOLDEN_TOLERANCE the largest accepted
+// difference per byte.
+// Results are printed as CSV lines:
+//   golden,scenario,frames,mismatches,max_difference,first_mismatch_frame,first_mismatch_offset
+// The scenarios are in golden_scenarios.h, also run on the host by
+// tools/nico_golden_frames.
+
+#include "golden_scenarios.h"
+
+#include <SdFat.h>
+
+#define GOLDEN_RECORD 0
+#define GOLDEN_TOLERANCE 0
+#define GOLDEN_SD_SEL 9
+
+SdFat sd;
+
+//-----------------------------------------------------------------------------
+static void run(const Scenario& scenario)
+{
+#if GOLDEN_RECORD
+  File file = sd.open(scenario.filename_, O_WRITE | O_CREAT | O_TRUNC);
+  FrameRecorder recorder(file);
+  renderScenario(scenario, &recorder, nullptr);
+  file.close();
+  Console::instance_ << F("recorded ") << scenario.filename_ << ": " << recorder.numFrames() << F(" frames\n");
+#else
+  File file = sd.open(scenario.filename_, O_READ);
+  FrameComparer comparer(file, GOLDEN_TOLERANCE);
+  if (not file || not renderScenario(scenario, nullptr, &comparer)) {
+    Console::instance_ << F("cannot read golden file ") << scenario.filename_ << "\n";
+    return;
+  }
+  file.close();
+  Console::instance_ << "golden," << scenario.name_ << "," << comparer.numFrames()
+    << "," << comparer.numMismatches() << "," << (unsigned int)comparer.maxDifference()
+    << "," << comparer.firstMismatchFrame() << "," << comparer.firstMismatchOffset() << "\n";
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void setup()
+{
+  Console::init();
+
+  if (not sd.begin(GOLDEN_SD_SEL, SPI_FULL_SPEED)) {
+    sd.initErrorHalt();
+  }
+
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+    run(scenarios[i]);
+  }
+  Console::instance_ << "# done\n";
+}
+
+void loop()
+{
+}
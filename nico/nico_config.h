@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NICO_CONFIG_H
+#define NICO_CONFIG_H
+
+// Build configuration of the nico libraries: capacities and buffer sizes.
+// Arduino compiles the library sources separately from the sketch, so a
+// #define in the sketch does not reach them. Worse, the capacities size
+// classes: a sketch seeing other values than the library would lay objects
+// out differently (memory corruption). Change the values here, or pass them
+// as global build flags (e.g. build_flags in platformio.ini, or
+// compiler.cpp.extra_flags in platform.local.txt).
+
+//-----------------------------------------------------------------------------
+// Memory
+
+#ifndef NICO_ARENA_SIZE
+#define NICO_ARENA_SIZE 0 // bytes, 0 for buffers on the heap
+#endif
+
+#ifndef NICO_MEMORY_MAX_ENTRIES
+#define NICO_MEMORY_MAX_ENTRIES 16
+#endif
+
+//-----------------------------------------------------------------------------
+// I2C bus
+
+#ifndef NICO_I2C_MAX_CLIENTS
+#define NICO_I2C_MAX_CLIENTS 8
+#endif
+
+//-----------------------------------------------------------------------------
+// IO expanders
+
+#ifndef NICO_IO_MAX_EXPANDERS
+#define NICO_IO_MAX_EXPANDERS 8 // addresses of the PCF8575 on a bus
+#endif
+
+//-----------------------------------------------------------------------------
+// NeoPixel
+
+#ifndef NICO_NEO_PIXEL_MAX_SNAKES
+#define NICO_NEO_PIXEL_MAX_SNAKES 4 // per NeoPixelBaseArray
+#endif
+
+#ifndef NICO_NEO_PIXEL_FRAME_PERIOD
+#define NICO_NEO_PIXEL_FRAME_PERIOD 20 // ms, least time between frames without a FrameGovernor
+#endif
+
+#ifndef NICO_NEO_PIXEL_MAX_PATTERNS
+#define NICO_NEO_PIXEL_MAX_PATTERNS 2 // per NeoPixel
+#endif
+
+//-----------------------------------------------------------------------------
+// Servos
+
+#ifndef NICO_SERVO_MAX_COUNT
+#define NICO_SERVO_MAX_COUNT 8 // channels used per driver, up to 16
+#endif
+
+//-----------------------------------------------------------------------------
+// MP3
+
+#ifndef NICO_MP3_MAX_TRACKS
+#define NICO_MP3_MAX_TRACKS 32
+#endif
+
+#ifndef NICO_MP3_BUFFER_SIZE
+#if defined(__AVR__)
+#define NICO_MP3_BUFFER_SIZE 256
+#else
+#define NICO_MP3_BUFFER_SIZE 4096
+#endif
+#endif
+
+#ifndef NICO_MP3_MAX_CLIPS
+#define NICO_MP3_MAX_CLIPS 4
+#endif
+
+#ifndef NICO_MP3_CLIP_HEAD_SIZE
+#if defined(__AVR__)
+#define NICO_MP3_CLIP_HEAD_SIZE 256
+#else
+#define NICO_MP3_CLIP_HEAD_SIZE 2048
+#endif
+#endif
+
+#ifndef NICO_FRAME_STREAM_READ_SIZE
+#define NICO_FRAME_STREAM_READ_SIZE 512 // bytes per update()
+#endif
+
+#endif
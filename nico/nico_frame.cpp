@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nico_frame.h"
+
+namespace {
+  const char Magic[4] = { 'N', 'F', 'R', 'M' };
+
+  void write16(Print& out, uint16_t val)
+  {
+    out.write(uint8_t(val));
+    out.write(uint8_t(val >> 8));
+  }
+
+  void write32(Print& out, uint32_t val)
+  {
+    write16(out, val);
+    write16(out, val >> 16);
+  }
+
+  bool readBytes(Stream& in, uint8_t* buffer, size_t size)
+  {
+    return (in.readBytes((char*)buffer, size) == size);
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool FrameHeader::read(Stream& in)
+{
+  uint8_t buffer[Size];
+  if (not readBytes(in, buffer, Size)
+      || memcmp(buffer, Magic, sizeof(Magic)) != 0
+      || buffer[4] != Version) {
+    return false;
+  }
+  bytesPerPixel_ = buffer[5];
+  numPixels_ = buffer[6] | (uint16_t(buffer[7]) << 8);
+  return true;
+}
+
+void FrameHeader::write(Print& out) const
+{
+  out.write((const uint8_t*)Magic, sizeof(Magic));
+  out.write(Version);
+  out.write(bytesPerPixel_);
+  write16(out, numPixels_);
+}
+
+//-----------------------------------------------------------------------------
+void FrameRecorder::begin(const NeoPixelRawArray& array)
+{
+  FrameHeader header;
+  header.bytesPerPixel_ = array.bytesPerPixel();
+  header.numPixels_ = array.size();
+  header.write(out_);
+  numFrames_ = 0;
+}
+
+void FrameRecorder::record(const NeoPixelRawArray& array)
+{
+  write32(out_, Clock::millis());
+  out_.write(array.pixels(), array.numBytes());
+  ++numFrames_;
+}
+
+//-----------------------------------------------------------------------------
+bool FrameComparer::begin(const NeoPixelRawArray& array)
+{
+  FrameHeader header;
+  if (not header.read(golden_)) {
+    return false;
+  }
+  numFrames_ = 0;
+  numMismatches_ = 0;
+  maxDifference_ = 0;
+  firstMismatchFrame_ = 0;
+  firstMismatchOffset_ = 0;
+  return (header.bytesPerPixel_ == array.bytesPerPixel()
+    && header.numPixels_ == array.size());
+}
+
+bool FrameComparer::compare(const NeoPixelRawArray& array)
+{
+  ++numFrames_;
+
+  uint8_t buffer[32];
+  if (not readBytes(golden_, buffer, 4)) { // time: informative only
+    mismatch(0);
+    return false;
+  }
+
+  const uint8_t* pixels = array.pixels();
+  const size_t numBytes = array.numBytes();
+  bool match = true;
+  for (size_t offset = 0; offset < numBytes; offset += sizeof(buffer)) {
+    const size_t size = (numBytes - offset < sizeof(buffer)) ? numBytes - offset : sizeof(buffer);
+    const size_t read = golden_.readBytes((char*)buffer, size);
+    if (read != size) {
+      if (match) {
+        mismatch(offset + read);
+      }
+      return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      const uint8_t diff = abs(int(buffer[i]) - int(pixels[offset + i]));
+      if (diff > maxDifference_) {
+        maxDifference_ = diff;
+      }
+      if (match && diff > tolerance_) {
+        mismatch(offset + i);
+        match = false;
+      }
+    }
+  }
+  return match;
+}
+
+void FrameComparer::mismatch(size_t offset)
+{
+  if (numMismatches_ == 0) {
+    firstMismatchFrame_ = numFrames_ - 1;
+    firstMismatchOffset_ = offset;
+  }
+  ++numMismatches_;
+}
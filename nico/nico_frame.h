@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NICO_FRAME_H
+#define NICO_FRAME_H
+
+#include "nico_neo_pixel.h"
+
+//-----------------------------------------------------------------------------
+// Binary capture of NeoPixel frames, in the wire layout of the strip:
+//   header: 'N' 'F' 'R' 'M', version, bytes per pixel, number of pixels (uint16)
+//   frame:  time (uint32, ms), pixel bytes
+// Integers are little endian.
+struct FrameHeader {
+  static const uint8_t Version = 1;
+  static const size_t Size = 8;
+
+  uint8_t bytesPerPixel_ = 0;
+  uint16_t numPixels_ = 0;
+
+  bool read(Stream& in);
+  void write(Print& out) const;
+};
+
+//-----------------------------------------------------------------------------
+class FrameRecorder {
+  public:
+    explicit FrameRecorder(Print& out) : out_(out) {}
+
+    void begin(const NeoPixelRawArray& array);
+    void record(const NeoPixelRawArray& array);
+    size_t numFrames() const { return numFrames_; }
+
+  private:
+    Print& out_;
+    size_t numFrames_ = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Compare frames against a capture made with FrameRecorder. A frame matches
+// when no byte differs by more than the tolerance.
+class FrameComparer {
+  public:
+    FrameComparer(Stream& golden, uint8_t tolerance = 0) : golden_(golden), tolerance_(tolerance) {}
+
+    bool begin(const NeoPixelRawArray& array);
+    bool compare(const NeoPixelRawArray& array);
+
+    size_t numFrames() const { return numFrames_; }
+    size_t numMismatches() const { return numMismatches_; }
+    uint8_t maxDifference() const { return maxDifference_; }
+    size_t firstMismatchFrame() const { return firstMismatchFrame_; } // from 0
+    size_t firstMismatchOffset() const { return firstMismatchOffset_; } // byte in that frame
+
+  private:
+    Stream& golden_;
+    const uint8_t tolerance_;
+    size_t numFrames_ = 0;
+    size_t numMismatches_ = 0;
+    uint8_t maxDifference_ = 0;
+    size_t firstMismatchFrame_ = 0;
+    size_t firstMismatchOffset_ = 0;
+
+    void mismatch(size_t offset); // of the first byte missing or out of tolerance
+};
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nico_i2c.h"
+
+//-----------------------------------------------------------------------------
+bool I2CArbiter::add(I2CClient& client, uint8_t priority, const char* name)
+{
+  if (clients_.full()) {
+    return false;
+  }
+
+  Client entry;
+  entry.client_ = &client;
+  entry.priority_ = priority;
+  entry.name_ = name;
+  entry.busTime_ = 0;
+  entry.transfers_ = 0;
+  entry.served_ = 0;
+
+  // sorted by priority, in the order added within a priority
+  size_t index = clients_.size();
+  clients_.push_back(entry);
+  for (; index > 0 && clients_[index - 1].priority_ > priority; --index) {
+    clients_[index] = clients_[index - 1];
+  }
+  clients_[index] = entry;
+
+  client.arbitrated_ = true;
+  if (statsTime_ == 0) {
+    statsTime_ = Clock::micros();
+  }
+  return true;
+}
+
+void I2CArbiter::update(unsigned long budget)
+{
+  const unsigned long startTime = Clock::micros();
+  const unsigned long first = transfers_; // served in this update: after it
+
+  for (;;) {
+    // highest priority, then least recently served
+    Client* next = nullptr;
+    for (size_t i = 0; i < clients_.size(); ++i) {
+      Client& client = clients_[i];
+      if (client.served_ > first) {
+        continue;
+      }
+      if (next != nullptr) {
+        if (client.priority_ != next->priority_) {
+          break; // sorted by priority
+        }
+        if (client.served_ >= next->served_) {
+          continue;
+        }
+      }
+      if (client.client_->pending()) {
+        next = &client;
+      }
+    }
+    if (next == nullptr) {
+      return;
+    }
+
+    const unsigned long time = Clock::micros();
+    if (next->priority_ != 0 && budget != 0 && time - startTime >= budget) {
+      ++deferrals_;
+      return;
+    }
+
+    next->client_->transfer();
+    next->busTime_ += Clock::micros() - time;
+    ++next->transfers_;
+    next->served_ = ++transfers_;
+  }
+}
+
+double I2CArbiter::utilization(size_t index) const
+{
+  const unsigned long duration = Clock::micros() - statsTime_;
+  return (duration != 0) ? double(clients_[index].busTime_) / duration : 0.0;
+}
+
+void I2CArbiter::resetStats()
+{
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    clients_[i].busTime_ = 0;
+    clients_[i].transfers_ = 0;
+  }
+  deferrals_ = 0;
+  statsTime_ = Clock::micros();
+}
+
+void I2CArbiter::printStats() const
+{
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    const Client& client = clients_[i];
+    Console::instance_ << F("I2C ");
+    if (client.name_ != nullptr) {
+      Console::instance_ << client.name_;
+    } else {
+      Console::instance_ << i;
+    }
+    Console::instance_ << F(": ") << client.transfers_ << F(" transfers, ")
+      << client.busTime_ << F("us, ") << (100.0 * utilization(i)) << F("%\n");
+  }
+  Console::instance_ << F("I2C deferrals: ") << deferrals_ << "\n";
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NICO_I2C_H
+#define NICO_I2C_H
+
+#include "nico_config.h"
+#include "nico_util.h"
+
+//-----------------------------------------------------------------------------
+// A device sharing an I2C bus through an I2CArbiter: it keeps its changes
+// until the arbiter lets it transfer them.
+class I2CClient {
+  public:
+    virtual bool pending() = 0; // something to transfer
+    virtual void transfer() = 0;
+
+    bool arbitrated() const { return arbitrated_; }
+
+  private:
+    friend class I2CArbiter;
+    bool arbitrated_ = false;
+};
+
+//-----------------------------------------------------------------------------
+// Runs the pending transfers of its clients from update(), by priority
+// (0 first). Clients of priority 0 always transfer, the others only until
+// the time budget is spent. Within a priority, the client served least
+// recently goes first. The time spent in each client is accounted as bus
+// time.
+class I2CArbiter : public Base {
+  public:
+    static const size_t MaxClients = NICO_I2C_MAX_CLIENTS;
+
+    explicit I2CArbiter(DebugMode debugMode = DebugMode::None) : Base(debugMode) {}
+
+    bool add(I2CClient& client, uint8_t priority, const char* name = nullptr); // false if full
+    void update(unsigned long budget = 0); // us, 0 for none
+
+    size_t size() const { return clients_.size(); }
+    unsigned long busTime(size_t index) const { return clients_[index].busTime_; } // us
+    unsigned long transfers(size_t index) const { return clients_[index].transfers_; }
+    double utilization(size_t index) const; // part of the time since resetStats()
+    unsigned long deferrals() const { return deferrals_; } // transfers left for lack of budget
+    void resetStats();
+    void printStats() const;
+
+  private:
+    struct Client {
+      I2CClient* client_;
+      uint8_t priority_;
+      const char* name_;
+      unsigned long busTime_; // us
+      unsigned long transfers_;
+      unsigned long served_; // transfer number
+    };
+
+    Array<Client, MaxClients> clients_; // by priority
+    unsigned long statsTime_ = 0; // us
+    unsigned long deferrals_ = 0;
+    unsigned long transfers_ = 0; // all clients
+};
+
+#endif
@@ -0,0 +1,298 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nico_io.h"
+
+//-----------------------------------------------------------------------------
+volatile unsigned long IOExpander::interrupts_ = 0;
+bool IOExpander::interruptAttached_ = false;
+
+void IOExpander::attachInterrupt(unsigned int pin)
+{
+  ::pinMode(pin, INPUT_PULLUP);
+  ::attachInterrupt(digitalPinToInterrupt(pin), onInterrupt, FALLING);
+  interruptAttached_ = true;
+}
+
+void IOExpander::onInterrupt()
+{
+  interrupts_ = interrupts_ + 1;
+}
+
+IOExpander::IOExpander(uint8_t address, TwoWire& wire, DebugMode debugMode)
+: Base(debugMode),
+  address_(address),
+  wire_(&wire)
+{
+}
+
+unsigned long IOExpander::interruptCount()
+{
+  noInterrupts();
+  const unsigned long count = interrupts_;
+  interrupts();
+  return count;
+}
+
+void IOExpander::init()
+{
+  if (debugMode() == DebugMode::DryRun) {
+    return;
+  }
+  expander_.begin(address_, wire_);
+  begun_ = true;
+  write();
+}
+
+void IOExpander::update()
+{
+  if (dirty_) {
+    write();
+  }
+  inputValid_ = false;
+
+  if (watched_ != 0) {
+    detectChanges();
+  } else if (interruptAttached_ && interruptCount() != interruptsSeen_) {
+    // The INT line is shared: an expander that is not read keeps it low,
+    // which masks the edges of the others. Reading clears it.
+    interruptsSeen_ = interruptCount();
+    readPort();
+  }
+}
+
+bool IOExpander::pending()
+{
+  if (dirty_ || inputValid_) {
+    return true;
+  }
+  if (watched_ == 0) {
+    return (interruptAttached_ && interruptCount() != interruptsSeen_);
+  }
+  return (not interruptAttached_ || not stableValid_ || bouncing_ != 0
+    || interruptCount() != interruptsSeen_);
+}
+
+void IOExpander::pinMode(size_t index, unsigned int mode)
+{
+  const uint16_t mask = uint16_t(1) << index;
+  if (mode == INPUT || mode == INPUT_PULLUP) {
+    inputs_ |= mask;
+    output_ |= mask;
+  } else {
+    inputs_ &= ~mask;
+    output_ &= ~mask; // low, as Adafruit_PCF8575::pinMode()
+  }
+  // right away, as pin modes always were: not batched by update()
+  if (begun_) {
+    write();
+  }
+}
+
+void IOExpander::digitalWrite(size_t index, bool value)
+{
+  const uint16_t mask = uint16_t(1) << index;
+  const uint16_t output = value ? (output_ | mask) : (output_ & ~mask);
+  writePort(output);
+}
+
+bool IOExpander::digitalRead(size_t index)
+{
+  return (readPort() >> index) & 1;
+}
+
+void IOExpander::writePort(uint16_t value)
+{
+  const uint16_t output = value | inputs_;
+  if (output != output_) {
+    output_ = output;
+    dirty_ = true;
+  }
+}
+
+uint16_t IOExpander::readPort()
+{
+  if (not inputValid_) {
+    if (debugMode() == DebugMode::DryRun) {
+      input_ = output_;
+    } else {
+      input_ = expander_.digitalReadWord();
+    }
+    inputValid_ = true;
+  }
+  return input_;
+}
+
+void IOExpander::write()
+{
+  if (debugMode() != DebugMode::DryRun) {
+    expander_.digitalWriteWord(output_);
+  }
+  dirty_ = false;
+}
+
+void IOExpander::onChange(size_t index, ChangeCallback callback)
+{
+  const uint16_t mask = uint16_t(1) << index;
+  callbacks_[index] = callback;
+  if (callback != nullptr) {
+    watched_ |= mask;
+  } else {
+    watched_ &= ~mask;
+    bouncing_ &= ~mask;
+  }
+}
+
+void IOExpander::detectChanges()
+{
+  if (interruptAttached_ && stableValid_ && bouncing_ == 0) {
+    const unsigned long count = interruptCount();
+    if (count == interruptsSeen_) {
+      return;
+    }
+    interruptsSeen_ = count; // before reading: a later change interrupts again
+  }
+
+  const uint16_t raw = readPort();
+  const uint16_t now = uint16_t(Clock::millis());
+  if (not stableValid_) {
+    stable_ = raw;
+    raw_ = raw;
+    stableValid_ = true;
+    return;
+  }
+
+  for (size_t i = 0; i < NumPins; ++i) {
+    const uint16_t mask = uint16_t(1) << i;
+    if ((watched_ & mask) == 0) {
+      continue;
+    }
+
+    if ((raw ^ stable_) & mask) {
+      if ((bouncing_ & mask) == 0 || ((raw ^ raw_) & mask)) {
+        // new value: wait until it holds
+        bouncing_ |= mask;
+        changeTimes_[i] = now;
+      }
+      if (uint16_t(now - changeTimes_[i]) >= debounce_) {
+        stable_ ^= mask;
+        bouncing_ &= ~mask;
+        callbacks_[i](pinOffset_ + i, (raw & mask) != 0);
+      }
+    } else {
+      bouncing_ &= ~mask; // glitch
+    }
+  }
+  stable_ = (stable_ & watched_) | (raw & ~watched_);
+  raw_ = raw;
+}
+
+//-----------------------------------------------------------------------------
+bool IOExpanderGroup::add(IOExpander& expander)
+{
+  if (expanders_.full()) {
+    return false;
+  }
+  expander.setPinOffset(numPins());
+  expanders_.push_back(&expander);
+  return true;
+}
+
+IOExpander* IOExpanderGroup::expander(size_t pin)
+{
+  const size_t index = pin / IOExpander::NumPins;
+  return (index < expanders_.size()) ? expanders_[index] : nullptr;
+}
+
+IOExpander* IOExpanderGroup::get(size_t pin)
+{
+  IOExpander* expander = this->expander(pin);
+  if (expander == nullptr && debugMode() != DebugMode::None) {
+    Console::instance_ << F("IO pin ") << pin << F(" out of range\n");
+  }
+  return expander;
+}
+
+void IOExpanderGroup::pinMode(size_t pin, unsigned int mode)
+{
+  IOExpander* expander = get(pin);
+  if (expander != nullptr) {
+    expander->pinMode(local(pin), mode);
+  }
+}
+
+void IOExpanderGroup::digitalWrite(size_t pin, bool value)
+{
+  IOExpander* expander = get(pin);
+  if (expander != nullptr) {
+    expander->digitalWrite(local(pin), value);
+  }
+}
+
+bool IOExpanderGroup::digitalRead(size_t pin)
+{
+  IOExpander* expander = get(pin);
+  return (expander != nullptr) ? expander->digitalRead(local(pin)) : false;
+}
+
+void IOExpanderGroup::onChange(size_t pin, IOExpander::ChangeCallback callback)
+{
+  IOExpander* expander = get(pin);
+  if (expander != nullptr) {
+    expander->onChange(local(pin), callback);
+  }
+}
+
+void IOExpanderGroup::init()
+{
+  for (size_t i = 0; i < expanders_.size(); ++i) {
+    expanders_[i]->init();
+  }
+}
+
+void IOExpanderGroup::update(unsigned long budget)
+{
+  const size_t size = expanders_.size();
+  const unsigned long startTime = Clock::micros();
+  for (size_t n = 0; n < size; ++n) {
+    const size_t i = (next_ + n) % size;
+    if (budget != 0 && n != 0 && Clock::micros() - startTime >= budget) {
+      next_ = i;
+      if (debugMode() != DebugMode::None) {
+        Console::instance_ << Console::Time << F("IO budget exceeded, ") << (size - n) << F(" expanders left\n");
+      }
+      return;
+    }
+    expanders_[i]->update();
+  }
+  next_ = 0;
+}
+
+void IOExpanderGroup::setDebounce(unsigned int duration)
+{
+  for (size_t i = 0; i < expanders_.size(); ++i) {
+    expanders_[i]->setDebounce(duration);
+  }
+}
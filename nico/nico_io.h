@@ -27,19 +27,116 @@
 
 #include <Arduino.h>
 #include <Adafruit_PCF8575.h>
+#include <Wire.h>
 
+#include "nico_config.h"
+#include "nico_i2c.h"
 #include "nico_util.h"
 
 //-----------------------------------------------------------------------------
-class IOExpander : public Base {
+// PCF8575: the 16 pins are written and read as one port.
+// Writes change a shadow of the port, sent in a single I2C write by update().
+// pinMode() writes the port right away, OUTPUT pins start low.
+// The port is read at most once between two update() calls.
+// Input pins are kept high, as the PCF8575 requires.
+// Input changes: update() calls the pin callbacks once a new value has been
+// stable for the debounce duration. With the INT line of the expanders wired
+// to an interrupt pin (see attachInterrupt()), the port is only read after an
+// interrupt or while a pin bounces; without, it is read at every update().
+// Every expander is read after an interrupt, watched pins or not, to release
+// the shared INT line.
+// Given to an I2CArbiter, it is updated by the arbiter.
+class IOExpander : public Base, public I2CClient {
   public:
+    static const size_t NumPins = 16;
+
+    typedef void (*ChangeCallback)(size_t index, bool value);
+
+    static void attachInterrupt(unsigned int pin); // INT lines of all expanders, open drain
+
     explicit IOExpander(DebugMode debugMode = DebugMode::None) : Base(debugMode) {}
-    void init() { expander_.begin(); }
-    
-    void pinMode(size_t index, unsigned int mode) { expander_.pinMode(index, mode); }
-    
+    explicit IOExpander(uint8_t address, TwoWire& wire = Wire, DebugMode debugMode = DebugMode::None);
+    void init();
+    void update();
+
+    void pinMode(size_t index, unsigned int mode); // INPUT, INPUT_PULLUP or OUTPUT
+    void digitalWrite(size_t index, bool value);
+    bool digitalRead(size_t index);
+    void writePort(uint16_t value); // output pins
+    uint16_t readPort();
+
+    void onChange(size_t index, ChangeCallback callback); // nullptr to remove
+    void setDebounce(unsigned int duration) { debounce_ = duration; } // ms
+    void setPinOffset(size_t offset) { pinOffset_ = offset; } // added to the index given to callbacks
+
+    uint8_t address() const { return address_; }
+
+    virtual bool pending();
+    virtual void transfer() { update(); }
+
   private:
+    static volatile unsigned long interrupts_;
+    static bool interruptAttached_;
+
+    const uint8_t address_ = PCF8575_I2CADDR_DEFAULT;
+    TwoWire* wire_ = &Wire;
     Adafruit_PCF8575 expander_;
+    uint16_t inputs_ = 0; // mask
+    uint16_t output_ = 0xffff; // shadow, 1 for the inputs
+    bool begun_ = false;
+    bool dirty_ = false; // output_ not written yet
+    uint16_t input_ = 0xffff; // last read
+    bool inputValid_ = false;
+
+    ChangeCallback callbacks_[NumPins] = {};
+    uint16_t watched_ = 0; // pins with a callback
+    unsigned int debounce_ = 20; // ms
+    size_t pinOffset_ = 0;
+    unsigned long interruptsSeen_ = 0;
+    uint16_t stable_ = 0xffff; // debounced input
+    bool stableValid_ = false;
+    uint16_t raw_ = 0xffff; // last read, watched pins
+    uint16_t bouncing_ = 0; // mask
+    uint16_t changeTimes_[NumPins] = {}; // ms, modulo 2^16
+
+    void write();
+    void detectChanges();
+    static void onInterrupt();
+    static unsigned long interruptCount();
+};
+
+//-----------------------------------------------------------------------------
+// Expanders on any addresses and buses as one flat range of pins: pins
+// 0-15 on the first expander added, 16-31 on the second, and so on.
+// update() only talks to the expanders with pending writes or input changes
+// to detect, and can be given a time budget: the expanders it did not reach
+// are the first to be updated by the next call.
+class IOExpanderGroup : public Base {
+  public:
+    static const size_t MaxExpanders = NICO_IO_MAX_EXPANDERS;
+
+    explicit IOExpanderGroup(DebugMode debugMode = DebugMode::None) : Base(debugMode) {}
+
+    bool add(IOExpander& expander); // false if full
+    size_t numPins() const { return expanders_.size() * IOExpander::NumPins; }
+    IOExpander* expander(size_t pin); // nullptr if out of range
+
+    void init();
+    void update(unsigned long budget = 0); // us, 0 for none
+
+    // pins out of range are ignored, read as low
+    void pinMode(size_t pin, unsigned int mode);
+    void digitalWrite(size_t pin, bool value);
+    bool digitalRead(size_t pin);
+    void onChange(size_t pin, IOExpander::ChangeCallback callback); // called with the group pin
+    void setDebounce(unsigned int duration); // ms
+
+  private:
+    Array<IOExpander*, MaxExpanders> expanders_;
+    size_t next_ = 0; // first to update
+
+    static size_t local(size_t pin) { return pin % IOExpander::NumPins; }
+    IOExpander* get(size_t pin); // with a message if out of range
 };
 
 #endif
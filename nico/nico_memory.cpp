@@ -0,0 +1,155 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nico_memory.h"
+#include "nico_util.h"
+
+#include <stdlib.h>
+
+//-----------------------------------------------------------------------------
+uint8_t Arena::data_[Size == 0 ? 1 : Size] __attribute__((aligned(8)));
+size_t Arena::used_ = 0;
+size_t Arena::last_ = Arena::None;
+size_t Arena::heapUsed_ = 0;
+Arena::Entry Arena::entries_[MaxEntries];
+size_t Arena::numEntries_ = 0;
+
+void* Arena::allocate(size_t size, const __FlashStringHelper* component)
+{
+  const size_t offset = (used_ + Alignment - 1) & ~(Alignment - 1);
+  if (Size != 0 && size != 0 && offset + HeaderSize + size <= Size) { // constant false without an arena
+    Header& arenaHeader = header(offset);
+    arenaHeader.component_ = component;
+    arenaHeader.size_ = size;
+    arenaHeader.previous_ = last_;
+    arenaHeader.released_ = false;
+    last_ = offset;
+    used_ = offset + HeaderSize + size;
+    account(component, size);
+    return &data_[offset + HeaderSize];
+  }
+
+  uint8_t* data = static_cast<uint8_t*>(malloc(HeaderSize + size));
+  if (data == nullptr) {
+    Console::instance_ << F("out of memory: ") << component << F(", ") << size << F(" bytes\n");
+    return nullptr;
+  }
+  Header& heapHeader = *reinterpret_cast<Header*>(data);
+  heapHeader.component_ = component;
+  heapHeader.size_ = size;
+  heapHeader.previous_ = None;
+  heapHeader.released_ = false;
+  account(component, size, true);
+  return data + HeaderSize;
+}
+
+void Arena::release(void* data)
+{
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  if (bytes == nullptr) {
+    return;
+  }
+  if (Size == 0 || bytes < data_ || bytes >= data_ + sizeof(data_)) {
+    unaccount(*reinterpret_cast<Header*>(bytes - HeaderSize), true);
+    free(bytes - HeaderSize);
+    return;
+  }
+  Header& arenaHeader = header(bytes - HeaderSize - data_);
+  unaccount(arenaHeader, false);
+  arenaHeader.released_ = true;
+  while (last_ != None && header(last_).released_) {
+    used_ = last_;
+    last_ = header(last_).previous_;
+  }
+}
+
+void Arena::account(const __FlashStringHelper* component, size_t size, bool heap)
+{
+  if (heap) {
+    heapUsed_ += size;
+  }
+
+  Entry* entry = find(component, true);
+  if (entry == nullptr) {
+    return; // only missing from the report
+  }
+  ++entry->count_;
+  entry->size_ += size;
+  if (heap) {
+    entry->heapSize_ += size;
+  }
+}
+
+void Arena::unaccount(const Header& header, bool heap)
+{
+  if (heap) {
+    heapUsed_ -= header.size_;
+  }
+
+  Entry* entry = find(header.component_, false);
+  if (entry == nullptr) {
+    return;
+  }
+  --entry->count_;
+  entry->size_ -= header.size_;
+  if (heap) {
+    entry->heapSize_ -= header.size_;
+  }
+}
+
+Arena::Entry* Arena::find(const __FlashStringHelper* component, bool add)
+{
+  for (size_t i = 0; i < numEntries_; ++i) {
+    if (entries_[i].component_ == component) {
+      return &entries_[i];
+    }
+  }
+  if (not add || numEntries_ == MaxEntries) {
+    return nullptr;
+  }
+  Entry* entry = &entries_[numEntries_++];
+  entry->component_ = component;
+  return entry;
+}
+
+void Arena::report()
+{
+  Console::instance_ << F("RAM arena: ") << used_ << F(" of ") << Size
+    << F(" bytes, heap: ") << heapUsed_ << F(" bytes\n");
+  for (size_t i = 0; i < numEntries_; ++i) {
+    const Entry& entry = entries_[i];
+    if (entry.count_ == 0) {
+      continue; // all released
+    }
+    Console::instance_ << F("  ") << entry.component_ << F(": ") << entry.size_ << F(" bytes");
+    if (entry.count_ > 1) {
+      Console::instance_ << F(" (") << entry.count_ << F(" times)");
+    }
+    if (entry.heapSize_ != 0) {
+      Console::instance_ << F(", ") << entry.heapSize_ << F(" on the heap");
+    }
+    Console::instance_ << "\n";
+  }
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NICO_MEMORY_H
+#define NICO_MEMORY_H
+
+#include "nico_config.h"
+
+#include <Arduino.h>
+
+//-----------------------------------------------------------------------------
+// Buffers are allocated once, at init, from a static arena sized at compile
+// time by NICO_ARENA_SIZE (see nico_config.h): no heap fragmentation in long-running units, and
+// the RAM shows in the static data size reported by the build. The heap is
+// used once the arena is full.
+// The RAM of each component (buffers, and objects through account()) is
+// listed by report(). Components are told apart by the address of their
+// name: use the same F() string for the same component. Released buffers are
+// taken off their component; heap buffers carry a header for it.
+class Arena {
+  public:
+    static const size_t Size = NICO_ARENA_SIZE;
+
+    static void* allocate(size_t size, const __FlashStringHelper* component); // nullptr if out of memory
+    // Arena space is reclaimed in reverse order of allocation: a buffer
+    // released before those allocated after it is reclaimed along with them.
+    static void release(void* data);
+    static void account(const __FlashStringHelper* component, size_t size, bool heap = false); // bytes allocated elsewhere
+
+    static size_t used() { return used_; } // arena bytes
+    static size_t heapUsed() { return heapUsed_; }
+    static void report();
+
+  private:
+#if defined(__AVR__)
+    static const size_t Alignment = 1;
+#else
+    static const size_t Alignment = 8;
+#endif
+    static const size_t MaxEntries = NICO_MEMORY_MAX_ENTRIES;
+
+    struct Header { // before each buffer
+      const __FlashStringHelper* component_;
+      size_t size_; // bytes
+      size_t previous_; // offset of the previous header, or None, arena only
+      bool released_;
+    };
+
+    static const size_t None = ~size_t(0);
+    static const size_t HeaderSize = (sizeof(Header) + Alignment - 1) & ~(Alignment - 1);
+
+    struct Entry {
+      const __FlashStringHelper* component_;
+      size_t count_;
+      size_t size_; // bytes
+      size_t heapSize_;
+    };
+
+    // plain data: components may be constructed before any constructor of this file runs
+    static uint8_t data_[Size == 0 ? 1 : Size] __attribute__((aligned(8)));
+    static size_t used_;
+    static size_t last_; // offset of the header of the last buffer, or None
+    static size_t heapUsed_;
+    static Entry entries_[MaxEntries];
+    static size_t numEntries_;
+
+    static Header& header(size_t offset) { return *reinterpret_cast<Header*>(&data_[offset]); }
+    static Entry* find(const __FlashStringHelper* component, bool add);
+    static void unaccount(const Header& header, bool heap);
+};
+
+#endif
@@ -25,41 +25,301 @@
 #include "nico_neo_pixel.h"
 
 //-----------------------------------------------------------------------------
+namespace {
+  // Gamma correction, from the table of Adafruit_NeoPixel or from a LUT in
+  // RAM with the brightness applied.
+  template <bool Lut>
+  inline uint8_t toOutput(uint8_t value, const uint8_t* lut)
+  {
+    return Lut ? lut[value] : Adafruit_NeoPixel::gamma8(value);
+  }
+
+  template <uint8_t R, uint8_t G, uint8_t B, uint8_t W, size_t N, bool Lut>
+  void writeRun(uint8_t* pixels, const uint32_t* colors, size_t size, const uint8_t* /*offsets*/, const uint8_t* lut)
+  {
+    for (size_t i = 0; i < size; ++i, pixels += N) {
+      const uint32_t color = colors[i];
+      pixels[R] = toOutput<Lut>(color >> 16, lut);
+      pixels[G] = toOutput<Lut>(color >> 8, lut);
+      pixels[B] = toOutput<Lut>(color, lut);
+      if (N == 4) {
+        pixels[W] = toOutput<Lut>(color >> 24, lut);
+      }
+    }
+  }
+
+  template <bool Lut>
+  void writeRunAny(uint8_t* pixels, const uint32_t* colors, size_t size, const uint8_t* offsets, const uint8_t* lut)
+  {
+    const size_t n = (offsets[3] == offsets[0]) ? 3 : 4;
+    for (size_t i = 0; i < size; ++i, pixels += n) {
+      const uint32_t color = colors[i];
+      pixels[offsets[0]] = toOutput<Lut>(color >> 16, lut);
+      pixels[offsets[1]] = toOutput<Lut>(color >> 8, lut);
+      pixels[offsets[2]] = toOutput<Lut>(color, lut);
+      if (n == 4) {
+        pixels[offsets[3]] = toOutput<Lut>(color >> 24, lut);
+      }
+    }
+  }
+
+  typedef void (*WriteRun)(uint8_t* pixels, const uint32_t* colors, size_t size, const uint8_t* offsets, const uint8_t* lut);
+
+  template <bool Lut>
+  WriteRun getWriteRun(unsigned int type)
+  {
+    switch (type) {
+      case NEO_GRB: return writeRun<1, 0, 2, 1, 3, Lut>;
+      case NEO_RGB: return writeRun<0, 1, 2, 0, 3, Lut>;
+      case NEO_GRBW: return writeRun<1, 0, 2, 3, 4, Lut>;
+      case NEO_RGBW: return writeRun<0, 1, 2, 3, 4, Lut>;
+      default: return writeRunAny<Lut>;
+    }
+  }
+}
+
 NeoPixelRawArray::NeoPixelRawArray(
   size_t       size,
   unsigned int pin,
   unsigned int type,
   DebugMode    debugMode)
 : Base(debugMode),
-  pixels_(size, pin, type + NEO_KHZ800)
+  pixels_(size, pin, type + NEO_KHZ800),
+  type_(type),
+  bytesPerPixel_((((type >> 6) & 3) == ((type >> 4) & 3)) ? 3 : 4) // white offset same as red: RGB
 {
+  offsets_[0] = (type >> 4) & 3;
+  offsets_[1] = (type >> 2) & 3;
+  offsets_[2] = type & 3;
+  offsets_[3] = (type >> 6) & 3;
+
+  writeRun_ = getWriteRun<false>(type);
+  toWire_ = writeRun_;
+  Arena::account(F("NeoPixel pixels"), numBytes(), true); // allocated by Adafruit_NeoPixel
+}
+
+NeoPixelRawArray::~NeoPixelRawArray()
+{
+  Arena::release(lut_);
+}
+
+const uint8_t* NeoPixelRawArray::pixels() const
+{
+  const uint8_t* latest = pipeline_.latest();
+  return (latest != nullptr) ? latest : pixels_.getPixels();
 }
 
 void NeoPixelRawArray::init()
 {
   // turn off all pixels even in DebugMode::DryRun
+  if (transport_ != nullptr) {
+    if (not transport_->begin(pixels_.getPin(), bytesPerPixel_, size())) {
+      Console::instance_ << F("cannot start NeoPixel transport\n");
+      transport_ = nullptr;
+    } else {
+      transport_->send(pixels_.getPixels());
+      return;
+    }
+  }
+
   pixels_.begin();
   pixels_.show();
 }
 
 void NeoPixelRawArray::clear()
 {
+  if (pipelined()) {
+    memset(pipeline_.acquire(), 0, numBytes());
+    pipeline_.publish();
+    return;
+  }
+
   pixels_.clear();
-  pixels_.show();
+  if (transport_ != nullptr) {
+    output(pixels_.getPixels());
+  } else {
+    pixels_.show();
+  }
 }
 
 void NeoPixelRawArray::set(size_t index, const Color& color)
 {
-    uint32_t c = pixels_.Color(color.r_, color.g_, color.b_, color.w_);
-    c = pixels_.gamma32(c);
-    pixels_.setPixelColor(index, c);
+    setPacked(index, PackedColor::pack(color));
+}
+
+void NeoPixelRawArray::setPacked(size_t index, uint32_t color)
+{
+  if (index >= size()) {
+    return;
+  }
+  writeRun_(frame() + index * bytesPerPixel_, &color, 1, offsets_, lut_);
+}
+
+void NeoPixelRawArray::setPacked(size_t index, const uint32_t* colors, size_t size)
+{
+  if (index >= this->size()) {
+    return;
+  }
+  if (size > this->size() - index) {
+    size = this->size() - index;
+  }
+  writeRun_(frame() + index * bytesPerPixel_, colors, size, offsets_, lut_);
+}
+
+uint8_t* NeoPixelRawArray::frame()
+{
+  return pipelined() ? pipeline_.acquire() : pixels_.getPixels();
+}
+
+void NeoPixelRawArray::toWire(uint32_t color, uint8_t* pixel) const
+{
+  toWire_(pixel, &color, 1, offsets_, nullptr);
 }
 
 void NeoPixelRawArray::show()
 {
-  if (debugMode() != DebugMode::DryRun) {
+  if (powerBudget_ != 0) {
+    limitPower(frame());
+  }
+
+  if (pipelined()) {
+    pipeline_.publish();
+    return;
+  }
+
+  output(pixels_.getPixels());
+}
+
+bool NeoPixelRawArray::busy()
+{
+  return (transport_ != nullptr && transport_->busy());
+}
+
+bool NeoPixelRawArray::enablePipeline()
+{
+  if (not pipeline_.init(numBytes())) {
+    Console::instance_ << F("not enough memory for NeoPixel pipeline\n");
+    return false;
+  }
+  return true;
+}
+
+void NeoPixelRawArray::serviceOutput()
+{
+  const uint8_t* frame = pipeline_.consume();
+  if (frame == nullptr) {
+    return;
+  }
+
+  if (transport_ != nullptr) {
+    output(frame); // copied by the transport
+    pipeline_.release();
+    return;
+  }
+
+  memcpy(pixels_.getPixels(), frame, numBytes());
+  pipeline_.release();
+  output(pixels_.getPixels());
+}
+
+bool NeoPixelRawArray::setPowerBudget(unsigned int budget, const PowerModel& model)
+{
+  if (budget != 0 && lut_ == nullptr) {
+    lut_ = static_cast<uint8_t*>(Arena::allocate(256, F("NeoPixel power LUT")));
+    if (lut_ == nullptr) {
+      Console::instance_ << F("not enough memory for NeoPixel power limit\n");
+      return false;
+    }
+  }
+
+  powerBudget_ = budget;
+  powerModel_ = model;
+  if (budget == 0) {
+    brightness_ = 255;
+    writeRun_ = getWriteRun<false>(type_);
+    return true;
+  }
+  setBrightness(255);
+  writeRun_ = getWriteRun<true>(type_);
+  return true;
+}
+
+void NeoPixelRawArray::setBrightness(uint8_t brightness)
+{
+  brightness_ = brightness;
+  for (size_t i = 0; i < 256; ++i) {
+    lut_[i] = (uint16_t(Adafruit_NeoPixel::gamma8(i)) * brightness + 127) / 255;
+  }
+}
+
+void NeoPixelRawArray::dim(uint8_t* pixels, size_t numBytes) const
+{
+  if (brightness_ == 255) {
+    return;
+  }
+  const uint16_t scale = brightness_ + 1;
+  for (size_t i = 0; i < numBytes; ++i) {
+    pixels[i] = (pixels[i] * scale) >> 8;
+  }
+}
+
+void NeoPixelRawArray::limitPower(uint8_t* frame)
+{
+  // A pass over the frame rather than a total kept as pixels are written:
+  // the frame is also written directly through frame(), and keeps the pixels
+  // not rewritten since the previous one, so the writers would have to read
+  // back each byte they replace. The pass is one add per byte.
+  // Wire values per channel: the current is linear in the PWM duty cycle.
+  uint32_t sums[4] = { 0, 0, 0, 0 };
+  const size_t n = bytesPerPixel_;
+  const size_t numBytes = this->numBytes();
+  for (size_t i = 0; i < numBytes; i += n) {
+    for (size_t k = 0; k < n; ++k) {
+      sums[k] += frame[i + k];
+    }
+  }
+  const double idle = powerModel_.idle_ * size();
+  double load = (sums[offsets_[0]] * powerModel_.red_ + sums[offsets_[1]] * powerModel_.green_
+    + sums[offsets_[2]] * powerModel_.blue_) / 255;
+  if (n == 4) {
+    load += sums[offsets_[3]] * powerModel_.white_ / 255;
+  }
+
+  // the frame is at brightness_, the load scales with it
+  const double available = powerBudget_ - idle;
+  if (load > available) {
+    // this frame is dimmed in place, the next ones when written
+    const uint16_t ratio = (available <= 0.0) ? 0 : uint16_t(available * 256 / load); // < 256, rounded down
+    for (size_t i = 0; i < numBytes; ++i) {
+      frame[i] = (frame[i] * ratio) >> 8;
+    }
+    load = load * ratio / 256;
+    setBrightness((brightness_ * ratio) >> 8);
+  } else if (brightness_ < 255) {
+    // raised if the frame would still fit
+    const uint8_t brightness = (255 - brightness_ > BrightnessStep) ? brightness_ + BrightnessStep : 255;
+    if (brightness_ == 0 || load * brightness / brightness_ <= available) {
+      setBrightness(brightness);
+    }
+  }
+  current_ = idle + load + 0.5;
+}
+
+void NeoPixelRawArray::output(const uint8_t* frame)
+{
+  if (debugMode() == DebugMode::DryRun) {
+    return;
+  }
+
+  if (transport_ == nullptr) {
     pixels_.show();
+    return;
+  }
+
+  while (transport_->busy()) {
+    yield();
   }
+  transport_->send(frame);
 }
 
 //-----------------------------------------------------------------------------
@@ -73,46 +333,182 @@ NeoPixelBaseArray::NeoPixelBaseArray(
   offset_(offset),
   size_(size)
 {
+  Arena::account(F("NeoPixelBaseArray"), sizeof(NeoPixelBaseArray));
+}
+
+NeoPixelBaseArray::~NeoPixelBaseArray()
+{
+  Arena::release(waveField_);
+  Arena::release(gradientField_);
+  Arena::release(litPixels_);
+  Arena::release(litBitmap_);
 }
 
 bool NeoPixelBaseArray::empty() const
 {
-   return (snakeDataVector_.empty() && pulseDataVector_.empty() && randomDataVector_.empty());
+   return (snakeDataVector_.empty() && pulseDataVector_.empty() && randomDataVector_.empty()
+     && gradientDataVector_.empty() && waveDataVector_.empty());
 }
 
 void NeoPixelBaseArray::clear()
 {
-  array_.clear();
+  array_.NeoPixelRawArray::clear(); // not NeoPixelArray's, which calls back
   snakeDataVector_.clear();
   pulseDataVector_.clear();
   randomDataVector_.clear();
+  gradientDataVector_.clear();
+  waveDataVector_.clear();
+  layers_.clear();
 }
 
-void NeoPixelBaseArray::add(const SnakeSetup& setup)
+void NeoPixelBaseArray::add(const SnakeSetup& setup, const Layer& layer)
 {
+  if (snakeDataVector_.full()) {
+    return;
+  }
   SnakeData data;
   data.setup_ = setup;
   data.beatKeeper_.reset(setup.duration_);
   data.index_ = setup.offset_;
+  addLayer(Snake, snakeDataVector_.size(), layer);
   snakeDataVector_.push_back(data);
 }
 
-void NeoPixelBaseArray::add(const PulseSetup& setup)
+void NeoPixelBaseArray::add(const PulseSetup& setup, const Layer& layer)
 {
+  if (pulseDataVector_.full()) {
+    return;
+  }
   PulseData data;
   data.setup_ = setup;
   data.beatKeeper_.reset(setup.duration_);
+  addLayer(Pulse, pulseDataVector_.size(), layer);
   pulseDataVector_.push_back(data);
 }
 
-void NeoPixelBaseArray::add(const RandomSetup& setup)
+void NeoPixelBaseArray::add(const RandomSetup& setup, const Layer& layer)
 {
+  if (randomDataVector_.full()) {
+    return;
+  }
   RandomData data;
   data.setup_ = setup;
   data.beatKeeper_.reset(setup.duration_);
+  data.count_ = (setup.count_ < size_) ? setup.count_ : size_;
+  if (not reserveLitPixels(data.count_)) {
+    Console::instance_ << F("not enough memory for NeoPixel random effect\n");
+    return;
+  }
+  addLayer(Random, randomDataVector_.size(), layer);
   randomDataVector_.push_back(data);
 }
 
+void NeoPixelBaseArray::add(const GradientSetup& setup, const Layer& layer)
+{
+  if (gradientDataVector_.full()) {
+    return;
+  }
+  GradientData data;
+  data.setup_ = setup;
+  data.beatKeeper_.reset(setup.duration_);
+  data.field_ = reserveField(gradientField_);
+  if (data.field_ == nullptr) {
+    return;
+  }
+
+  // position along the direction, scaled to half a cycle from end to end
+  const double angle = setup.angle_ * M_PI / 180;
+  const double dx = cos(angle);
+  const double dy = sin(angle);
+  double min = 0.0;
+  double max = 0.0;
+  for (size_t i = 0; i < size_; ++i) {
+    const double position = dx * map_->x(i) + dy * map_->y(i);
+    min = (i == 0 || position < min) ? position : min;
+    max = (i == 0 || position > max) ? position : max;
+  }
+  for (size_t i = 0; i < size_; ++i) {
+    const double position = dx * map_->x(i) + dy * map_->y(i);
+    data.field_[i] = (max - min < 1e-6) ? 0 : uint8_t((position - min) * 127 / (max - min) + 0.5);
+  }
+
+  addLayer(Gradient, gradientDataVector_.size(), layer);
+  gradientDataVector_.push_back(data);
+}
+
+void NeoPixelBaseArray::add(const WaveSetup& setup, const Layer& layer)
+{
+  if (waveDataVector_.full()) {
+    return;
+  }
+  WaveData data;
+  data.setup_ = setup;
+  data.beatKeeper_.reset(setup.duration_);
+  data.field_ = reserveField(waveField_);
+  if (data.field_ == nullptr) {
+    return;
+  }
+
+  // distance to the center, a cycle per wavelength
+  const double wavelength = (setup.wavelength_ > 0.0) ? 255 * setup.wavelength_ : 255;
+  for (size_t i = 0; i < size_; ++i) {
+    const double dx = map_->x(i) - 255 * setup.x_;
+    const double dy = map_->y(i) - 255 * setup.y_;
+    const double dz = map_->z(i) - 255 * setup.z_;
+    data.field_[i] = uint8_t(uint32_t(sqrt(dx * dx + dy * dy + dz * dz) * 256 / wavelength));
+  }
+
+  addLayer(Wave, waveDataVector_.size(), layer);
+  waveDataVector_.push_back(data);
+}
+
+void NeoPixelBaseArray::addLayer(LayerType type, size_t index, const Layer& layer)
+{
+  LayerRef ref;
+  ref.type_ = type;
+  ref.index_ = index;
+  ref.layer_ = layer;
+  layers_.push_back(ref);
+  added_ = true;
+}
+
+uint8_t* NeoPixelBaseArray::reserveField(uint8_t*& field)
+{
+  if (map_ == nullptr || map_->size() < size_) {
+    Console::instance_ << F("no pixel map for NeoPixel spatial effect\n");
+    return nullptr;
+  }
+  if (field == nullptr) {
+    field = static_cast<uint8_t*>(Arena::allocate(size_, F("NeoPixel spatial")));
+    if (field == nullptr) {
+      Console::instance_ << F("not enough memory for NeoPixel spatial effect\n");
+    }
+  }
+  return field;
+}
+
+bool NeoPixelBaseArray::reserveLitPixels(size_t count)
+{
+  // kept between effects, arena memory is not reclaimed
+  const size_t bitmapSize = (size_ + 7) / 8;
+  if (litBitmap_ == nullptr) {
+    litBitmap_ = static_cast<uint8_t*>(Arena::allocate(bitmapSize, F("NeoPixel random")));
+    if (litBitmap_ == nullptr) {
+      return false;
+    }
+  }
+  if (count > litCapacity_) {
+    Arena::release(litPixels_);
+    litPixels_ = static_cast<uint16_t*>(Arena::allocate(count * sizeof(uint16_t), F("NeoPixel random")));
+    litCapacity_ = (litPixels_ == nullptr) ? 0 : count;
+    if (litPixels_ == nullptr) {
+      return false;
+    }
+  }
+  memset(litBitmap_, 0, bitmapSize);
+  return true;
+}
+
 void NeoPixelBaseArray::set(size_t i, const Color& color)
 {
     array_.set(offset_ + i, color);
@@ -120,6 +516,14 @@ void NeoPixelBaseArray::set(size_t i, const Color& color)
 
 void NeoPixelBaseArray::update()
 {
+  if (governor_ != nullptr && not governor_->due()) {
+    return;
+  }
+  const unsigned long time = Clock::millis();
+  if (governor_ == nullptr && rendered_ && time - frameTime_ < framePeriod_) {
+    return;
+  }
+
   bool needUpdate = false;
   for (size_t k = 0; k < snakeDataVector_.size(); ++k) {
     needUpdate |= increment(snakeDataVector_[k]);
@@ -130,57 +534,134 @@ void NeoPixelBaseArray::update()
   for (size_t k = 0; k < randomDataVector_.size(); ++k) {
     needUpdate |= increment(randomDataVector_[k]);
   }
+  for (size_t k = 0; k < gradientDataVector_.size(); ++k) {
+    needUpdate |= increment(gradientDataVector_[k]);
+  }
+  for (size_t k = 0; k < waveDataVector_.size(); ++k) {
+    needUpdate |= increment(waveDataVector_[k]);
+  }
+  needUpdate |= added_;
+  needUpdate |= (not layers_.empty() && brightness_ != array_.brightness()); // see setPowerBudget()
+  added_ = false;
   if (not needUpdate) {
     return;
   }
 
-  for (size_t i = 0; i < size_; ++i) {
-    Color color;
-    for (size_t k = 0; k < snakeDataVector_.size(); ++k) {
-      addColor(i, snakeDataVector_[k], color);
-    }
-    for (size_t k = 0; k < pulseDataVector_.size(); ++k) {
-      addColor(i, pulseDataVector_[k], color);
-    }
-    for (size_t k = 0; k < randomDataVector_.size(); ++k) {
-      addColor(i, randomDataVector_[k], color);
+  rendered_ = true;
+  frameTime_ = time;
+  if (governor_ == nullptr) {
+    render();
+    return;
+  }
+
+  quality_ = governor_->quality();
+  governor_->begin();
+  render();
+  governor_->end();
+}
+
+void NeoPixelBaseArray::render()
+{
+  // composite the layers one tile at a time, several channels at once,
+  // starting from the topmost one hiding those below
+  const bool smooth = (quality_ == FrameGovernor::High);
+  const bool firstSnakeOnly = (quality_ == FrameGovernor::Low);
+  const size_t firstLayer = getFirstLayer();
+
+  uint32_t colors[TileSize];
+  for (size_t begin = 0; begin < size_; begin += TileSize) {
+    const size_t size = (size_ - begin < TileSize) ? size_ - begin : TileSize;
+    PackedColor::fill(colors, size, 0);
+    for (size_t k = firstLayer; k < layers_.size(); ++k) {
+      const LayerRef& ref = layers_[k];
+      if (ref.layer_.opacity_ == 0 || (firstSnakeOnly && ref.type_ == Snake && ref.index_ != 0)) {
+        continue;
+      }
+      switch (ref.type_) {
+        case Snake:
+          blend(begin, size, snakeDataVector_[ref.index_], ref.layer_, smooth, colors);
+          break;
+        case Pulse:
+          blend(begin, size, pulseDataVector_[ref.index_], ref.layer_, colors);
+          break;
+        case Random:
+          blend(begin, size, randomDataVector_[ref.index_], ref.layer_, colors);
+          break;
+        case Gradient:
+          blend(begin, size, gradientDataVector_[ref.index_], ref.layer_, colors);
+          break;
+        case Wave:
+          blend(begin, size, waveDataVector_[ref.index_], ref.layer_, colors);
+          break;
+      }
     }
 
-//    Console::instance_ << color.r_ <<  " " << color.g_ << " " << color.b_ << " " << color.w_ << "\n";
-    array_.set(offset_ + i, color);
+    array_.setPacked(offset_ + begin, colors, size);
   }
 
+  brightness_ = array_.brightness(); // rendered again by update() once show() changes it
   array_.show();
 }
 
+size_t NeoPixelBaseArray::getFirstLayer() const
+{
+  // random effects and gradients cover every pixel
+  for (size_t k = layers_.size(); k > 0; --k) {
+    const LayerType type = layers_[k - 1].type_;
+    if ((type == Random || type == Gradient) && layers_[k - 1].layer_.opaque()) {
+      return k - 1;
+    }
+  }
+  return 0;
+}
+
 bool NeoPixelBaseArray::increment(SnakeData& data) const
 {
-  const size_t numBeats = data.beatKeeper_.getNumBeats();
-  if (numBeats == 0) {
+  const unsigned int duration = data.setup_.duration_;
+  if (duration == 0 || size_ == 0) {
     return false;
   }
 
-  for (size_t i = 0; i < numBeats; ++i) {
-    incrementPixelIndex(data.index_, data.setup_.dir_);
+  const unsigned long time = data.beatKeeper_.elapsed();
+  const size_t steps = (time / duration) % size_;
+  size_t index = data.setup_.offset_ % size_;
+  if (data.setup_.dir_ == CCW) {
+    index = (index + size_ - steps) % size_;
+  } else {
+    index = (index + steps) % size_;
+  }
+  const uint16_t fraction = uint32_t(time % duration) * PackedColor::One / duration;
+
+  if (index == data.index_ && fraction == data.fraction_) {
+    return false;
   }
+  data.index_ = index;
+  data.fraction_ = fraction;
   return true;
 }
 
 bool NeoPixelBaseArray::increment(PulseData& data) const
 {
-  const size_t numBeats = data.beatKeeper_.getNumBeats();
-  if (numBeats == 0) {
+  const unsigned int duration = data.setup_.duration_;
+  if (duration == 0) {
     return false;
   }
 
-  data.level_ += numBeats;
-  data.level_ %= 2;
+  // triangle: up for a duration, down for the next
+  const unsigned long phase = data.beatKeeper_.elapsed() % (2UL * duration);
+  const unsigned long level = (phase < duration) ? phase : 2UL * duration - phase;
+  const uint16_t gamma = level * PackedColor::One / duration;
+
+  if (gamma == data.level_) {
+    return false;
+  }
+  data.level_ = gamma;
   return true;
 }
 
-bool NeoPixelBaseArray::increment(RandomData& data) const
+bool NeoPixelBaseArray::increment(RandomData& data)
 {
-  if (data.setup_.count_ == 0) {
+  if (data.count_ == 0) {
     return false;
   }
 
@@ -189,41 +670,132 @@ bool NeoPixelBaseArray::increment(RandomData& data) const
     return false;
   }
 
-  const size_t pixelIndex = random(0, size_);
-  if (data.index_ == data.pixelIndexes_.size()) {
-    data.pixelIndexes_.push_back(pixelIndex);
-  } else {
-    data.pixelIndexes_[data.index_] = pixelIndex;
+  // one pixel per beat, even when frames were skipped, each lit once
+  for (size_t beat = 0; beat < numBeats && beat < data.count_; ++beat) {
+    if (data.numLit_ == data.count_) {
+      const uint16_t oldest = litPixels_[data.index_];
+      litBitmap_[oldest >> 3] &= ~(1 << (oldest & 7));
+    } else {
+      ++data.numLit_;
+    }
+    size_t pixel = Prng::below(size_);
+    while (litBitmap_[pixel >> 3] & (1 << (pixel & 7))) {
+      pixel = (pixel + 1 == size_) ? 0 : pixel + 1;
+    }
+    litBitmap_[pixel >> 3] |= 1 << (pixel & 7);
+    litPixels_[data.index_] = pixel;
+    data.index_ = (data.index_ + 1) % data.count_;
   }
-  data.index_ = (data.index_ + 1) % data.setup_.count_;
   return true;
 }
 
-void NeoPixelBaseArray::addColor(size_t i, const SnakeData& data, Color& color) const
+// a cycle of 256 from the time since the effect was added
+static uint8_t getPhase(const BeatKeeper& beatKeeper)
+{
+  const unsigned int duration = beatKeeper.duration();
+  return (duration == 0) ? 0 : (beatKeeper.elapsed() % duration) * 256 / duration;
+}
+
+// 0 up to 255 and back over a cycle
+static uint8_t triangle(uint8_t phase)
+{
+  return (phase < 128) ? 2 * phase : 2 * (255 - phase) + 1;
+}
+
+bool NeoPixelBaseArray::increment(GradientData& data) const
 {
-  const size_t dist = getPixelDistance(i, data.index_, data.setup_.dir_);
-  double gamma = 0.0;
-  if (dist < data.setup_.length_) {
-    gamma = (1.0 - data.setup_.fadeFactor_ * (double)dist / (size_ - 1));
+  const uint8_t phase = getPhase(data.beatKeeper_);
+  if (phase == data.phase_) {
+    return false;
   }
-  color.add(data.setup_.color_, gamma);
+  data.phase_ = phase;
+  return true;
 }
 
-void NeoPixelBaseArray::addColor(size_t /*i*/, const PulseData& data, Color& color) const
+bool NeoPixelBaseArray::increment(WaveData& data) const
 {
-  const double gamma = (data.level_ == 0) ? 0.0 : 1.0;
-  color.add(data.setup_.color_, gamma);
+  const uint8_t phase = getPhase(data.beatKeeper_);
+  if (phase == data.phase_) {
+    return false;
+  }
+  data.phase_ = phase;
+  return true;
 }
 
-void NeoPixelBaseArray::addColor(size_t i, const RandomData& data, Color& color) const
+void NeoPixelBaseArray::blend(size_t begin, size_t size, const SnakeData& data, const Layer& layer, bool smooth, uint32_t* colors) const
 {
-  for (size_t k = 0; k < data.pixelIndexes_.size(); ++k) {
-    if (data.pixelIndexes_[k] == i) {
-      color = data.setup_.color_;
-      return;
+  // between the head pixel and the next one: both positions blended,
+  // which anti-aliases the head and the tail
+  const uint32_t color = PackedColor::pack(data.setup_.color_);
+  const double fraction = double(data.fraction_) / PackedColor::One;
+  size_t next = data.index_;
+  incrementPixelIndex(next, data.setup_.dir_);
+  for (size_t i = 0; i < size; ++i) {
+    double gamma = getSnakeGamma(data.setup_, getPixelDistance(begin + i, data.index_, data.setup_.dir_));
+    if (smooth && data.fraction_ != 0) {
+      const double nextGamma = getSnakeGamma(data.setup_, getPixelDistance(begin + i, next, data.setup_.dir_));
+      gamma += fraction * (nextGamma - gamma);
+    }
+    if (gamma > 0.0) {
+      const uint16_t alpha = PackedColor::combine(layer.opacity_, PackedColor::toFixed(gamma));
+      colors[i] = PackedColor::blend(colors[i], color, layer.blend_, alpha);
     }
   }
-  color = data.setup_.backgroundColor_;
+}
+
+void NeoPixelBaseArray::blend(size_t /*begin*/, size_t size, const PulseData& data, const Layer& layer, uint32_t* colors) const
+{
+  const uint16_t alpha = PackedColor::combine(layer.opacity_, data.level_);
+  PackedColor::blend(colors, size, PackedColor::pack(data.setup_.color_), layer.blend_, alpha);
+}
+
+void NeoPixelBaseArray::blend(size_t begin, size_t size, const RandomData& data, const Layer& layer, uint32_t* colors) const
+{
+  // background with the lit pixels, composited in place when replacing
+  uint32_t src[TileSize];
+  uint32_t* dst = layer.opaque() ? colors : src;
+  PackedColor::fill(dst, size, PackedColor::pack(data.setup_.backgroundColor_));
+  if (data.numLit_ != 0) {
+    // tiles start on a byte of the bitmap
+    const uint32_t color = PackedColor::pack(data.setup_.color_);
+    for (size_t i = 0; i < size; i += 8) {
+      const uint8_t bits = litBitmap_[(begin + i) >> 3];
+      for (size_t j = 0; bits >> j; ++j) {
+        if (bits & (1 << j) && i + j < size) {
+          dst[i + j] = color;
+        }
+      }
+    }
+  }
+  if (dst == src) {
+    PackedColor::blend(colors, src, size, layer.blend_, layer.opacity_);
+  }
+}
+
+void NeoPixelBaseArray::blend(size_t begin, size_t size, const GradientData& data, const Layer& layer, uint32_t* colors) const
+{
+  const uint32_t color1 = PackedColor::pack(data.setup_.color1_);
+  const uint32_t color2 = PackedColor::pack(data.setup_.color2_);
+  uint32_t src[TileSize];
+  uint32_t* dst = layer.opaque() ? colors : src;
+  for (size_t i = 0; i < size; ++i) {
+    const uint8_t level = triangle(data.field_[begin + i] + data.phase_);
+    dst[i] = PackedColor::lerp(color1, color2, level + (level >> 7));
+  }
+  if (dst == src) {
+    PackedColor::blend(colors, src, size, layer.blend_, layer.opacity_);
+  }
+}
+
+void NeoPixelBaseArray::blend(size_t begin, size_t size, const WaveData& data, const Layer& layer, uint32_t* colors) const
+{
+  // crests moving outwards as the phase grows
+  const uint32_t color = PackedColor::pack(data.setup_.color_);
+  for (size_t i = 0; i < size; ++i) {
+    const uint8_t level = triangle(data.field_[begin + i] - data.phase_);
+    const uint16_t alpha = PackedColor::combine(layer.opacity_, level + (level >> 7));
+    colors[i] = PackedColor::blend(colors[i], color, layer.blend_, alpha);
+  }
 }
 
 void NeoPixelBaseArray::incrementPixelIndex(size_t& index, Direction dir) const
@@ -235,6 +807,14 @@ void NeoPixelBaseArray::incrementPixelIndex(size_t& index, Direction dir) const
   }
 }
 
+double NeoPixelBaseArray::getSnakeGamma(const SnakeSetup& setup, size_t dist) const
+{
+  if (dist >= setup.length_) {
+    return 0.0;
+  }
+  return (1.0 - setup.fadeFactor_ * (double)dist / (size_ - 1));
+}
+
 size_t NeoPixelBaseArray::getPixelDistance(size_t i, size_t index, Direction dir) const
 {
   if (dir == CCW) {
@@ -244,6 +824,86 @@ size_t NeoPixelBaseArray::getPixelDistance(size_t i, size_t index, Direction dir
   }
 }
 
+//-----------------------------------------------------------------------------
+NeoPixelPaletteArray::NeoPixelPaletteArray(
+  NeoPixelRawArray& array,
+  size_t            offset,
+  size_t            size,
+  size_t            paletteSize,
+  DebugMode         debugMode)
+: Base(debugMode),
+  array_(array),
+  offset_(offset),
+  size_(size),
+  paletteSize_((paletteSize <= 16) ? 16 : 256)
+{
+}
+
+bool NeoPixelPaletteArray::init()
+{
+  indexes_ = static_cast<uint8_t*>(Arena::allocate(size_, F("NeoPixel palette pixels")));
+  palette_ = static_cast<uint8_t*>(Arena::allocate(paletteSize_ * array_.bytesPerPixel(), F("NeoPixel palettes")));
+  if (indexes_ == nullptr || palette_ == nullptr) {
+    Console::instance_ << F("not enough memory for NeoPixel palette\n");
+    return false;
+  }
+  memset(indexes_, 0, size_);
+  memset(palette_, 0, paletteSize_ * array_.bytesPerPixel());
+  return true;
+}
+
+void NeoPixelPaletteArray::setPalette(size_t entry, const Color& color)
+{
+  if (entry < paletteSize_) {
+    array_.toWire(PackedColor::pack(color), palette_ + entry * array_.bytesPerPixel());
+    changed_ = true;
+  }
+}
+
+void NeoPixelPaletteArray::set(size_t i, uint8_t entry)
+{
+  entry &= paletteSize_ - 1;
+  if (i < size_ && indexes_[i] != entry) {
+    indexes_[i] = entry;
+    changed_ = true;
+  }
+}
+
+void NeoPixelPaletteArray::fill(uint8_t entry)
+{
+  memset(indexes_, entry & (paletteSize_ - 1), size_);
+  changed_ = true;
+}
+
+void NeoPixelPaletteArray::update()
+{
+  if (changed_ || brightness_ != array_.brightness()) {
+    render();
+  }
+}
+
+void NeoPixelPaletteArray::render()
+{
+  const size_t n = array_.bytesPerPixel();
+  uint8_t* pixels = array_.frame() + offset_ * n;
+  if (n == 3) {
+    for (size_t i = 0; i < size_; ++i, pixels += 3) {
+      const uint8_t* color = palette_ + 3 * indexes_[i];
+      pixels[0] = color[0];
+      pixels[1] = color[1];
+      pixels[2] = color[2];
+    }
+  } else {
+    for (size_t i = 0; i < size_; ++i, pixels += n) {
+      memcpy(pixels, palette_ + n * indexes_[i], n);
+    }
+  }
+  array_.dim(array_.frame() + offset_ * n, size_ * n);
+  brightness_ = array_.brightness(); // rendered again by update() once show() changes it
+  changed_ = false;
+  array_.show();
+}
+
 //-----------------------------------------------------------------------------
 NeoPixelArray::NeoPixelArray(
   size_t       size,
@@ -255,19 +915,29 @@ NeoPixelArray::NeoPixelArray(
 {
 }
 
-void NeoPixelArray::add(const SnakeSetup& setup)
+void NeoPixelArray::add(const SnakeSetup& setup, const Layer& layer)
+{
+  array_.add(setup, layer);
+}
+
+void NeoPixelArray::add(const PulseSetup& setup, const Layer& layer)
+{
+  array_.add(setup, layer);
+}
+
+void NeoPixelArray::add(const RandomSetup& setup, const Layer& layer)
 {
-  array_.add(setup);
+  array_.add(setup, layer);
 }
 
-void NeoPixelArray::add(const PulseSetup& setup)
+void NeoPixelArray::add(const GradientSetup& setup, const Layer& layer)
 {
-  array_.add(setup);
+  array_.add(setup, layer);
 }
 
-void NeoPixelArray::add(const RandomSetup& setup)
+void NeoPixelArray::add(const WaveSetup& setup, const Layer& layer)
 {
-  array_.add(setup);
+  array_.add(setup, layer);
 }
 
 void NeoPixelArray::clear()
@@ -288,6 +958,7 @@ NeoPixel::NeoPixel(
   DebugMode    debugMode)
 : NeoPixelRawArray(1, pin, type, debugMode)
 {
+  Arena::account(F("NeoPixel patterns"), sizeof(patterns_));
 }
 
 void NeoPixel::addPattern(Pattern* pattern)
@@ -315,12 +986,20 @@ void NeoPixel::update()
     patterns_[i]->increment();
   }
 
+  // patterns below an opaque one are hidden
+  size_t first = patterns_.size();
+  while (first > 0 && not patterns_[first - 1]->opaque()) {
+    --first;
+  }
+  first = (first == 0) ? 0 : first - 1;
+
   for (size_t i = 0; i < size(); ++i) {
-      Color color;
-      for (size_t k = 0; k < patterns_.size(); ++k) {
-        patterns_[k]->setColor(i, color);
-      }
-    set(i, color);
+    uint32_t color = 0;
+    for (size_t k = first; k < patterns_.size(); ++k) {
+      const Layer& layer = patterns_[k]->layer();
+      color = PackedColor::blend(color, patterns_[k]->color(i), layer.blend_, layer.opacity_);
+    }
+    setPacked(i, color);
   }
 
   show();
@@ -25,79 +25,256 @@
 #ifndef NICO_NEO_PIXEL_H
 #define NICO_NEO_PIXEL_H
 
-#include "nico_neo_pixel_util.h"
+#include "nico_config.h"
+#include "nico_neo_pixel_blend.h"
+#include "nico_neo_pixel_map.h"
+#include "nico_neo_pixel_transport.h"
+#include "nico_triple_buffer.h"
 
 #include <Adafruit_NeoPixel.h>
 
 // NeoPixel on RP2040: GRB
 // Individual NeoPixel: RGB
 
+//-----------------------------------------------------------------------------
+// Current drawn by a pixel: idle, plus each channel in proportion to its
+// wire value. Defaults: WS2812B, about 20 mA per channel at full.
+struct PowerModel {
+  double idle_ = 1.0; // mA
+  double red_ = 20.0; // mA at 255
+  double green_ = 20.0;
+  double blue_ = 20.0;
+  double white_ = 20.0;
+};
+
 //-----------------------------------------------------------------------------
 class NeoPixelRawArray : public Base {
   public:
     NeoPixelRawArray(size_t size, unsigned int pin, unsigned int type, DebugMode debugMode);
+    ~NeoPixelRawArray();
 
     size_t size() const { return pixels_.numPixels(); }
+    size_t bytesPerPixel() const { return bytesPerPixel_; }
+    size_t numBytes() const { return bytesPerPixel_ * size(); }
+    const uint8_t* pixels() const; // wire layout
 
     void init();
     virtual void clear();
     void set(size_t index, const Color&);
+    void setPacked(size_t index, uint32_t color); // see PackedColor
+    void setPacked(size_t index, const uint32_t* colors, size_t size); // consecutive pixels
     void show();
 
+    // Wire layout: the strip's byte order, gamma corrected. The writer for
+    // the common layouts is generated at compile time.
+    uint8_t* frame(); // being built
+    void toWire(uint32_t color, uint8_t* pixel) const; // full brightness, see setPowerBudget()
+
+    // Pipeline mode: set() and show() render into a back buffer and do not
+    // wait for the strip, frames are sent by serviceOutput(). On RP2040 call
+    // it from loop1() so that output runs on the second core.
+    bool enablePipeline(); // before init()
+    bool pipelined() const { return (pipeline_.size() != 0); }
+    void serviceOutput();
+
+    // Non-blocking output instead of the Adafruit_NeoPixel bit-banging,
+    // show() only waits if the previous frame is still being sent.
+    void setTransport(NeoPixelTransport* transport) { transport_ = transport; } // before init()
+    bool busy(); // previous frame still being sent
+
+    // Power limiting: show() estimates the current of the frame, and lowers
+    // the brightness to fit the budget, the frame included. It is raised back
+    // gradually when the next frames allow it. Pixels are expected at the
+    // current brightness: set() applies it through the output LUT, content
+    // written in the wire layout at full brightness is passed to dim().
+    // A frame over the budget is dimmed in place: pixels that are not
+    // written again keep that brightness when it is raised back. Effects
+    // and palette arrays render again when it changes, pixels written by the
+    // sketch must be rewritten at every frame.
+    bool setPowerBudget(unsigned int budget, const PowerModel& model = PowerModel()); // mA, 0 for none
+    unsigned int powerBudget() const { return powerBudget_; }
+    unsigned int current() const { return current_; } // mA, estimated for the last frame shown
+    uint8_t brightness() const { return brightness_; } // 255 for full
+    void dim(uint8_t* pixels, size_t numBytes) const; // from full to brightness(), in place
+
   private:
+    static const uint8_t BrightnessStep = 8; // raised per frame
+
     Adafruit_NeoPixel pixels_;
+    const unsigned int type_;
+    const size_t bytesPerPixel_;
+    uint8_t offsets_[4]; // r, g, b, w in wire layout
+    void (*writeRun_)(uint8_t* pixels, const uint32_t* colors, size_t size, const uint8_t* offsets, const uint8_t* lut);
+    void (*toWire_)(uint8_t* pixels, const uint32_t* colors, size_t size, const uint8_t* offsets, const uint8_t* lut); // full brightness
+    TripleBuffer pipeline_;
+    NeoPixelTransport* transport_ = nullptr;
+    unsigned int powerBudget_ = 0;
+    PowerModel powerModel_;
+    unsigned int current_ = 0;
+    uint8_t brightness_ = 255;
+    uint8_t* lut_ = nullptr; // gamma and brightness
+
+    void output(const uint8_t* frame);
+    void limitPower(uint8_t* frame);
+    void setBrightness(uint8_t brightness);
 };
 
 //-----------------------------------------------------------------------------
 class NeoPixelBaseArray : public Base {
   public:
     NeoPixelBaseArray(NeoPixelRawArray& array, size_t offset, size_t size, DebugMode debugMode);
+    ~NeoPixelBaseArray();
 
     bool empty() const;
 
     void clear();
     void update();
+    void render(); // unconditionally, without advancing effects
+
+    // Frames paced by the governor: update() only renders when a frame is
+    // due. Lower qualities render snakes without sub-pixel motion (Medium),
+    // and only the first snake (Low).
+    void setGovernor(FrameGovernor* governor) { governor_ = governor; }
+    // Without a governor, frames are at least this far apart: effects move
+    // by sub-pixel steps, and showing each of them would keep interrupts off
+    // most of the time while bit-banging.
+    void setFramePeriod(unsigned int period) { framePeriod_ = period; } // ms, 0 for none
 
-    void add(const SnakeSetup& setup);
-    void add(const PulseSetup& setup);
-    void add(const RandomSetup& setup);
+    // Effects are layers composited in the order they were added, in a
+    // single pass per tile of pixels. Random effects and gradients replace
+    // the layers below by default.
+    void add(const SnakeSetup& setup, const Layer& layer = Layer(BlendMode::Add));
+    void add(const PulseSetup& setup, const Layer& layer = Layer(BlendMode::Add));
+    void add(const RandomSetup& setup, const Layer& layer = Layer(BlendMode::AlphaOver));
     void set(size_t i, const Color& color);
 
+    // Spatial effects need the map of the pixels, of the array size. Their
+    // value for each pixel is computed when added, only its phase changes
+    // with time.
+    void setMap(const PixelMap* map) { map_ = map; }
+    void add(const GradientSetup& setup, const Layer& layer = Layer(BlendMode::AlphaOver));
+    void add(const WaveSetup& setup, const Layer& layer = Layer(BlendMode::Add));
+
   private:
+    static const size_t TileSize = 16; // pixels composited at once
+    static const size_t MaxLayers = NICO_NEO_PIXEL_MAX_SNAKES + 4;
+
+    enum LayerType { Snake, Pulse, Random, Gradient, Wave };
+
+    struct LayerRef {
+      LayerType type_;
+      uint8_t index_; // in the vector of its type
+      Layer layer_;
+    };
+
+    // snakes and pulses are functions of the time since they were added,
+    // sampled by update()
     struct SnakeData {
       SnakeSetup setup_;
       BeatKeeper beatKeeper_;
-      size_t index_ = 0;
+      size_t index_ = 0; // head
+      uint16_t fraction_ = 0; // of the way to the next pixel, PackedColor::One for all
     };
 
     struct PulseData {
       PulseSetup setup_;
       BeatKeeper beatKeeper_;
-      unsigned int level_ = 0;
+      uint16_t level_ = 0; // PackedColor::One for full
     };
 
+    // one pixel lit per beat, the oldest going off once count are lit
     struct RandomData {
       RandomSetup setup_;
       BeatKeeper beatKeeper_;
-      Array<size_t, 8> pixelIndexes_;
-      size_t index_ = 0;
+      size_t count_ = 0; // at most the array size
+      size_t numLit_ = 0;
+      size_t index_ = 0; // oldest in litPixels_
+    };
+
+    // field_: per pixel, offset by phase_ (a full cycle is 256)
+    struct GradientData {
+      GradientSetup setup_;
+      BeatKeeper beatKeeper_;
+      uint8_t* field_ = nullptr;
+      uint8_t phase_ = 0;
+    };
+
+    struct WaveData {
+      WaveSetup setup_;
+      BeatKeeper beatKeeper_;
+      uint8_t* field_ = nullptr;
+      uint8_t phase_ = 0;
     };
 
     NeoPixelRawArray& array_;
     const size_t offset_;
     const size_t size_;
-    Array<SnakeData, 4> snakeDataVector_;
+    Array<SnakeData, NICO_NEO_PIXEL_MAX_SNAKES> snakeDataVector_;
     Array<PulseData, 1> pulseDataVector_;
     Array<RandomData, 1> randomDataVector_;
+    Array<GradientData, 1> gradientDataVector_;
+    Array<WaveData, 1> waveDataVector_;
+    Array<LayerRef, MaxLayers> layers_;
+    uint16_t* litPixels_ = nullptr; // random effect, in the order they were lit
+    size_t litCapacity_ = 0;
+    uint8_t* litBitmap_ = nullptr; // same pixels, 1 bit each
+    const PixelMap* map_ = nullptr;
+    bool added_ = false; // rendered by the next update()
+    uint8_t* gradientField_ = nullptr; // kept between effects
+    uint8_t* waveField_ = nullptr;
+    FrameGovernor* governor_ = nullptr;
+    FrameGovernor::Quality quality_ = FrameGovernor::High;
+    unsigned int framePeriod_ = NICO_NEO_PIXEL_FRAME_PERIOD; // ms
+    unsigned long frameTime_ = 0; // ms, last rendered
+    bool rendered_ = false;
+    uint8_t brightness_ = 255; // of the array, as rendered
 
     bool increment(SnakeData& data) const;
     bool increment(PulseData& data) const;
-    bool increment(RandomData& data) const;
-    void addColor(size_t i, const SnakeData& data, Color& color) const;
-    void addColor(size_t i, const PulseData& data, Color& color) const;
-    void addColor(size_t i, const RandomData& data, Color& color) const;
+    bool increment(RandomData& data);
+    bool increment(GradientData& data) const;
+    bool increment(WaveData& data) const;
+    void addLayer(LayerType type, size_t index, const Layer& layer);
+    bool reserveLitPixels(size_t count);
+    uint8_t* reserveField(uint8_t*& field);
+    size_t getFirstLayer() const; // lowest visible
+    void blend(size_t begin, size_t size, const SnakeData& data, const Layer& layer, bool smooth, uint32_t* colors) const;
+    void blend(size_t begin, size_t size, const PulseData& data, const Layer& layer, uint32_t* colors) const;
+    void blend(size_t begin, size_t size, const RandomData& data, const Layer& layer, uint32_t* colors) const;
+    void blend(size_t begin, size_t size, const GradientData& data, const Layer& layer, uint32_t* colors) const;
+    void blend(size_t begin, size_t size, const WaveData& data, const Layer& layer, uint32_t* colors) const;
     void incrementPixelIndex(size_t& index, Direction dir) const;
     size_t getPixelDistance(size_t i, size_t index, Direction dir) const;
+    double getSnakeGamma(const SnakeSetup& setup, size_t dist) const;
+};
+
+//-----------------------------------------------------------------------------
+// Pixels as palette entries, 1 byte each instead of a Color: the palette is
+// converted to the wire layout when set, render() only copies bytes.
+class NeoPixelPaletteArray : public Base {
+  public:
+    NeoPixelPaletteArray(NeoPixelRawArray& array, size_t offset, size_t size, size_t paletteSize, DebugMode debugMode); // 16 or 256 entries
+
+    bool init(); // false if out of memory
+    size_t size() const { return size_; }
+    size_t paletteSize() const { return paletteSize_; }
+
+    void setPalette(size_t entry, const Color& color);
+    void set(size_t i, uint8_t entry);
+    uint8_t get(size_t i) const { return indexes_[i]; }
+    void fill(uint8_t entry);
+    void update(); // render() if changed
+    void render();
+
+  private:
+    NeoPixelRawArray& array_;
+    const size_t offset_;
+    const size_t size_;
+    const size_t paletteSize_;
+    uint8_t* indexes_ = nullptr;
+    uint8_t* palette_ = nullptr; // wire layout
+    bool changed_ = true;
+    uint8_t brightness_ = 255; // of the array, as rendered
 };
 
 //-----------------------------------------------------------------------------
@@ -105,12 +282,17 @@ class NeoPixelArray : public NeoPixelRawArray {
   public:
     NeoPixelArray(size_t numPixels, unsigned int pin, unsigned int type, DebugMode debugMode);
     
-    void add(const SnakeSetup& setup);
-    void add(const PulseSetup& setup);
-    void add(const RandomSetup& setup);
+    void add(const SnakeSetup& setup, const Layer& layer = Layer(BlendMode::Add));
+    void add(const PulseSetup& setup, const Layer& layer = Layer(BlendMode::Add));
+    void add(const RandomSetup& setup, const Layer& layer = Layer(BlendMode::AlphaOver));
+    void setMap(const PixelMap* map) { array_.setMap(map); }
+    void add(const GradientSetup& setup, const Layer& layer = Layer(BlendMode::AlphaOver));
+    void add(const WaveSetup& setup, const Layer& layer = Layer(BlendMode::Add));
     
     virtual void clear();
     void update();
+    void setGovernor(FrameGovernor* governor) { array_.setGovernor(governor); }
+    void setFramePeriod(unsigned int period) { array_.setFramePeriod(period); }
 
   private:
     NeoPixelBaseArray array_;
@@ -127,7 +309,7 @@ class NeoPixel : public NeoPixelRawArray {
     void update();
 
   private:
-    Array<Pattern*, 2> patterns_;
+    Array<Pattern*, NICO_NEO_PIXEL_MAX_PATTERNS> patterns_;
 };
 
 //-----------------------------------------------------------------------------
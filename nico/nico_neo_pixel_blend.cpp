@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nico_neo_pixel_blend.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//-----------------------------------------------------------------------------
+void PackedColor::fill(uint32_t* dst, size_t size, uint32_t color)
+{
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = color;
+  }
+}
+
+void PackedColor::add(uint32_t* dst, size_t size, uint32_t color)
+{
+  if (color == 0) {
+    return;
+  }
+
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i c = _mm_set1_epi32(color);
+  for (; i + 4 <= size; i += 4) {
+    __m128i* p = (__m128i*)(dst + i);
+    _mm_storeu_si128(p, _mm_adds_epu8(_mm_loadu_si128(p), c));
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t c = vreinterpretq_u8_u32(vdupq_n_u32(color));
+  for (; i + 4 <= size; i += 4) {
+    uint8_t* p = (uint8_t*)(dst + i);
+    vst1q_u8(p, vqaddq_u8(vld1q_u8(p), c));
+  }
+#endif
+  for (; i < size; ++i) {
+    dst[i] = addSaturate(dst[i], color);
+  }
+}
+
+void PackedColor::add(uint32_t* dst, const uint32_t* src, size_t size)
+{
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 4 <= size; i += 4) {
+    __m128i* p = (__m128i*)(dst + i);
+    const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_si128(p, _mm_adds_epu8(_mm_loadu_si128(p), s));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 4 <= size; i += 4) {
+    uint8_t* p = (uint8_t*)(dst + i);
+    vst1q_u8(p, vqaddq_u8(vld1q_u8(p), vld1q_u8((const uint8_t*)(src + i))));
+  }
+#endif
+  for (; i < size; ++i) {
+    dst[i] = addSaturate(dst[i], src[i]);
+  }
+}
+
+void PackedColor::scale(uint32_t* dst, size_t size, uint16_t gamma)
+{
+  if (gamma >= One) {
+    return;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = scale(dst[i], gamma);
+  }
+}
+
+void PackedColor::blend(uint32_t* dst, size_t size, uint32_t color, BlendMode mode, uint16_t alpha)
+{
+  if (alpha == 0) {
+    return;
+  }
+
+  switch (mode) {
+    case BlendMode::Add:
+      add(dst, size, (alpha >= One) ? color : scale(color, alpha));
+      return;
+    case BlendMode::AlphaOver:
+      if (alpha >= One) {
+        fill(dst, size, color);
+        return;
+      }
+      break;
+    default:
+      break;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = blend(dst[i], color, mode, alpha);
+  }
+}
+
+void PackedColor::blend(uint32_t* dst, const uint32_t* src, size_t size, BlendMode mode, uint16_t alpha)
+{
+  if (alpha == 0) {
+    return;
+  }
+
+  if (mode == BlendMode::Add && alpha >= One) {
+    add(dst, src, size);
+    return;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = blend(dst[i], src[i], mode, alpha);
+  }
+}
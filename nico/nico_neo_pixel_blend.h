@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NICO_NEO_PIXEL_BLEND_H
+#define NICO_NEO_PIXEL_BLEND_H
+
+#include "nico_neo_pixel_util.h"
+
+//-----------------------------------------------------------------------------
+// Colors packed in 32 bits in the Adafruit_NeoPixel layout (w, r, g, b from
+// most to least significant byte), blended with all four channels in one
+// operation (SWAR). Frame functions process several pixels per instruction
+// with SSE2 or NEON when available.
+namespace PackedColor {
+  const uint16_t One = 256; // gamma 1.0 in 8.8 fixed point
+
+  inline uint32_t pack(const Color& color)
+  {
+    return (uint32_t(color.w_) << 24) | (uint32_t(color.r_) << 16) | (uint32_t(color.g_) << 8) | color.b_;
+  }
+
+  inline Color unpack(uint32_t color)
+  {
+    return Color(color >> 16, color >> 8, color, color >> 24);
+  }
+
+  // gamma clamped to [0, 1]
+  inline uint16_t toFixed(double gamma)
+  {
+    return (gamma <= 0.0) ? 0 : (gamma >= 1.0) ? One : uint16_t(gamma * One + 0.5);
+  }
+
+  // gamma <= One
+  inline uint32_t scale(uint32_t color, uint16_t gamma)
+  {
+    const uint32_t rb = ((color & 0x00FF00FF) * gamma + 0x00800080) >> 8;
+    const uint32_t wg = ((color >> 8) & 0x00FF00FF) * gamma + 0x00800080;
+    return (rb & 0x00FF00FF) | (wg & 0xFF00FF00);
+  }
+
+  inline uint32_t addSaturate(uint32_t a, uint32_t b)
+  {
+    const uint32_t high = 0x80808080;
+    const uint32_t sum = (a & ~high) + (b & ~high);
+    const uint32_t carry = ((a & b) | ((a | b) & sum)) & high;
+    return (sum ^ ((a ^ b) & high)) | ((carry >> 7) * 0xFF);
+  }
+
+  // a * b, 0xFF being 1
+  inline uint32_t multiply(uint32_t a, uint32_t b)
+  {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      const uint32_t x = (a >> shift) & 0xFF;
+      const uint32_t y = (b >> shift) & 0xFF;
+      result |= ((x * y + 0x80 + ((x * y + 0x80) >> 8)) >> 8) << shift;
+    }
+    return result;
+  }
+
+  inline uint32_t max(uint32_t a, uint32_t b)
+  {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      const uint32_t x = a & (0xFFUL << shift);
+      const uint32_t y = b & (0xFFUL << shift);
+      result |= (x > y) ? x : y;
+    }
+    return result;
+  }
+
+  // a to b, alpha <= One
+  inline uint32_t lerp(uint32_t a, uint32_t b, uint16_t alpha)
+  {
+    return addSaturate(scale(a, One - alpha), scale(b, alpha));
+  }
+
+  // 8.8 fixed point product, such as a layer opacity by an effect level
+  inline uint16_t combine(uint16_t a, uint16_t b)
+  {
+    return (uint32_t(a) * b) >> 8;
+  }
+
+  // src onto dst, alpha being the layer opacity times its coverage of the
+  // pixel: Multiply by white and the others with black leave dst unchanged
+  // at alpha 0, all apply src fully at One.
+  inline uint32_t blend(uint32_t dst, uint32_t src, BlendMode mode, uint16_t alpha)
+  {
+    switch (mode) {
+      case BlendMode::Add:
+        return addSaturate(dst, (alpha >= One) ? src : scale(src, alpha));
+      case BlendMode::Multiply:
+        return (alpha >= One) ? multiply(dst, src) : lerp(dst, multiply(dst, src), alpha);
+      case BlendMode::Max:
+        return max(dst, (alpha >= One) ? src : scale(src, alpha));
+      case BlendMode::AlphaOver:
+        return (alpha >= One) ? src : lerp(dst, src, alpha);
+    }
+    return dst;
+  }
+
+  void fill(uint32_t* dst, size_t size, uint32_t color);
+  void add(uint32_t* dst, size_t size, uint32_t color); // saturating
+  void add(uint32_t* dst, const uint32_t* src, size_t size); // saturating
+  void scale(uint32_t* dst, size_t size, uint16_t gamma);
+  void blend(uint32_t* dst, size_t size, uint32_t color, BlendMode mode, uint16_t alpha);
+  void blend(uint32_t* dst, const uint32_t* src, size_t size, BlendMode mode, uint16_t alpha);
+}
+
+#endif
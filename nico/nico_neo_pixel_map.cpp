@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nico_neo_pixel_map.h"
+
+//-----------------------------------------------------------------------------
+PixelMap::PixelMap(DebugMode debugMode)
+: Base(debugMode)
+{
+}
+
+PixelMap::~PixelMap()
+{
+  Arena::release(coords_);
+  Arena::release(indexes_);
+}
+
+bool PixelMap::allocate(size_t size, size_t numCells)
+{
+  if (coords_ != nullptr) {
+    Console::instance_ << F("pixel map already initialized\n");
+    return false;
+  }
+  if (numCells != 0) {
+    indexes_ = static_cast<uint16_t*>(Arena::allocate(numCells * sizeof(uint16_t), F("PixelMap")));
+  }
+  coords_ = static_cast<uint8_t*>(Arena::allocate(3 * size, F("PixelMap")));
+  if (coords_ == nullptr || (numCells != 0 && indexes_ == nullptr)) {
+    Console::instance_ << F("not enough memory for pixel map\n");
+    return false;
+  }
+  size_ = size;
+  return true;
+}
+
+bool PixelMap::initMatrix(size_t width, size_t height, bool serpentine, bool columns)
+{
+  if (width == 0 || height == 0 || not allocate(width * height, width * height)) {
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+
+  const size_t side = ((width > height) ? width : height) - 1;
+  for (size_t y = 0; y < height; ++y) {
+    for (size_t x = 0; x < width; ++x) {
+      // position along the wiring: line, then cell in the line
+      const size_t line = columns ? x : y;
+      const size_t lineSize = columns ? height : width;
+      size_t cell = columns ? y : x;
+      if (serpentine && line % 2 == 1) {
+        cell = lineSize - 1 - cell;
+      }
+      const size_t i = line * lineSize + cell;
+
+      indexes_[y * width + x] = i;
+      coords_[3 * i] = (side == 0) ? 0 : x * 255 / side;
+      coords_[3 * i + 1] = (side == 0) ? 0 : y * 255 / side;
+      coords_[3 * i + 2] = 0;
+    }
+  }
+
+  if (debugMode() != DebugMode::None) {
+    Console::instance_ << F("pixel map: ") << width << F("x") << height << F(" matrix\n");
+  }
+  return true;
+}
+
+bool PixelMap::init(const Point* points, size_t size)
+{
+  if (size == 0 || not allocate(size, 0)) {
+    return false;
+  }
+
+  Point min = points[0];
+  Point max = points[0];
+  for (size_t i = 1; i < size; ++i) {
+    min.x_ = (points[i].x_ < min.x_) ? points[i].x_ : min.x_;
+    min.y_ = (points[i].y_ < min.y_) ? points[i].y_ : min.y_;
+    min.z_ = (points[i].z_ < min.z_) ? points[i].z_ : min.z_;
+    max.x_ = (points[i].x_ > max.x_) ? points[i].x_ : max.x_;
+    max.y_ = (points[i].y_ > max.y_) ? points[i].y_ : max.y_;
+    max.z_ = (points[i].z_ > max.z_) ? points[i].z_ : max.z_;
+  }
+  long side = long(max.x_) - min.x_;
+  side = (long(max.y_) - min.y_ > side) ? long(max.y_) - min.y_ : side;
+  side = (long(max.z_) - min.z_ > side) ? long(max.z_) - min.z_ : side;
+
+  for (size_t i = 0; i < size; ++i) {
+    coords_[3 * i] = (side == 0) ? 0 : (long(points[i].x_) - min.x_) * 255 / side;
+    coords_[3 * i + 1] = (side == 0) ? 0 : (long(points[i].y_) - min.y_) * 255 / side;
+    coords_[3 * i + 2] = (side == 0) ? 0 : (long(points[i].z_) - min.z_) * 255 / side;
+  }
+
+  if (debugMode() != DebugMode::None) {
+    Console::instance_ << F("pixel map: ") << size << F(" points\n");
+  }
+  return true;
+}
+
+int PixelMap::index(size_t x, size_t y) const
+{
+  if (x >= width_ || y >= height_) {
+    return -1;
+  }
+  return indexes_[y * width_ + x];
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NICO_NEO_PIXEL_MAP_H
+#define NICO_NEO_PIXEL_MAP_H
+
+#include "nico_util.h"
+
+//-----------------------------------------------------------------------------
+// Where the pixels of an array are, computed once by init: the pixel index
+// of each matrix cell, and the coordinates of each pixel for the spatial
+// effects. Coordinates are scaled uniformly so that the largest side of the
+// bounding box spans 0..255, effects use the same units as 0..1.
+class PixelMap : public Base {
+  public:
+    struct Point {
+      int16_t x_;
+      int16_t y_;
+      int16_t z_;
+    };
+
+    explicit PixelMap(DebugMode debugMode = DebugMode::None);
+    ~PixelMap();
+
+    // Matrix wired row by row from (0, 0), or column by column. Serpentine:
+    // every other row (column) runs backwards.
+    bool initMatrix(size_t width, size_t height, bool serpentine, bool columns = false);
+    // Pixel i at points[i], e.g. measured on a sculpture.
+    bool init(const Point* points, size_t size);
+
+    size_t size() const { return size_; }
+    size_t width() const { return width_; } // matrix only
+    size_t height() const { return height_; }
+    int index(size_t x, size_t y) const; // pixel, -1 outside the matrix
+
+    uint8_t x(size_t i) const { return coords_[3 * i]; }
+    uint8_t y(size_t i) const { return coords_[3 * i + 1]; }
+    uint8_t z(size_t i) const { return coords_[3 * i + 2]; }
+
+  private:
+    size_t size_ = 0;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    uint16_t* indexes_ = nullptr; // matrix cell to pixel
+    uint8_t* coords_ = nullptr; // x, y, z per pixel
+
+    bool allocate(size_t size, size_t numCells);
+};
+
+#endif
@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NICO_NEO_PIXEL_STRIP_H
+#define NICO_NEO_PIXEL_STRIP_H
+
+#include "nico_neo_pixel_blend.h"
+#include "nico_neo_pixel_transport.h"
+#include "nico_util.h"
+
+#include <Adafruit_NeoPixel.h>
+
+//-----------------------------------------------------------------------------
+// Adafruit_NeoPixel sending a buffer it does not own, through its protected
+// members: the library has no other way to output a static buffer.
+class NeoPixelOutput : public Adafruit_NeoPixel {
+  public:
+    NeoPixelOutput(uint8_t* pixels, size_t numPixels, size_t numBytes, unsigned int pin, unsigned int type);
+    ~NeoPixelOutput() { pixels = nullptr; } // not to be freed
+};
+
+//-----------------------------------------------------------------------------
+// Strip of N pixels on a given pin and color order (NEO_GRB...), all known
+// at compile time: the buffer is a member, the byte order is resolved by the
+// compiler and loops have constant trip counts. Sent by Adafruit_NeoPixel
+// or by a transport.
+// Only for raw pixel writes by the sketch: effects, maps and the power limit
+// of NeoPixelArray (see nico_neo_pixel.h) do not apply to it.
+template <size_t N, unsigned int Pin, unsigned int Order>
+class NeoPixelStrip : public Base {
+  public:
+    static const size_t Size = N;
+    static const size_t BytesPerPixel = (((Order >> 6) & 3) == ((Order >> 4) & 3)) ? 3 : 4; // white offset same as red: RGB
+    static const size_t NumBytes = N * BytesPerPixel;
+
+    explicit NeoPixelStrip(DebugMode debugMode = DebugMode::None);
+
+    void setTransport(NeoPixelTransport* transport) { transport_ = transport; } // before init()
+    void init();
+
+    size_t size() const { return N; }
+    uint8_t* pixels() { return pixels_; } // wire layout
+    const uint8_t* pixels() const { return pixels_; }
+
+    void clear() { memset(pixels_, 0, NumBytes); }
+    void set(size_t index, const Color& color) { setPacked(index, PackedColor::pack(color)); }
+    void setPacked(size_t index, uint32_t color); // see PackedColor
+    void setPacked(size_t index, const uint32_t* colors, size_t size); // consecutive pixels
+    void fill(uint32_t color);
+    void show();
+    bool busy() { return (transport_ != nullptr && transport_->busy()); }
+
+  private:
+    static const size_t R = (Order >> 4) & 3;
+    static const size_t G = (Order >> 2) & 3;
+    static const size_t B = Order & 3;
+    static const size_t W = (Order >> 6) & 3;
+
+    uint8_t pixels_[NumBytes] = {};
+    NeoPixelOutput output_;
+    NeoPixelTransport* transport_ = nullptr;
+
+    static void toWire(uint32_t color, uint8_t* pixel);
+};
+
+//-----------------------------------------------------------------------------
+template <size_t N, unsigned int Pin, unsigned int Order>
+NeoPixelStrip<N, Pin, Order>::NeoPixelStrip(DebugMode debugMode)
+: Base(debugMode),
+  output_(pixels_, N, NumBytes, Pin, Order)
+{
+  Arena::account(F("NeoPixelStrip"), sizeof(*this));
+}
+
+template <size_t N, unsigned int Pin, unsigned int Order>
+void NeoPixelStrip<N, Pin, Order>::init()
+{
+  // turn off all pixels even in DebugMode::DryRun
+  if (transport_ != nullptr) {
+    if (transport_->begin(Pin, BytesPerPixel, N)) {
+      transport_->send(pixels_);
+      return;
+    }
+    Console::instance_ << F("cannot start NeoPixel transport\n");
+    transport_ = nullptr;
+  }
+
+  output_.begin();
+  output_.show();
+}
+
+template <size_t N, unsigned int Pin, unsigned int Order>
+void NeoPixelStrip<N, Pin, Order>::setPacked(size_t index, uint32_t color)
+{
+  if (index < N) {
+    toWire(color, pixels_ + index * BytesPerPixel);
+  }
+}
+
+template <size_t N, unsigned int Pin, unsigned int Order>
+void NeoPixelStrip<N, Pin, Order>::setPacked(size_t index, const uint32_t* colors, size_t size)
+{
+  if (index >= N) {
+    return;
+  }
+  if (size > N - index) {
+    size = N - index;
+  }
+  uint8_t* pixel = pixels_ + index * BytesPerPixel;
+  for (size_t i = 0; i < size; ++i, pixel += BytesPerPixel) {
+    toWire(colors[i], pixel);
+  }
+}
+
+template <size_t N, unsigned int Pin, unsigned int Order>
+void NeoPixelStrip<N, Pin, Order>::fill(uint32_t color)
+{
+  uint8_t wire[BytesPerPixel];
+  toWire(color, wire);
+  uint8_t* pixel = pixels_;
+  for (size_t i = 0; i < N; ++i, pixel += BytesPerPixel) {
+    for (size_t k = 0; k < BytesPerPixel; ++k) {
+      pixel[k] = wire[k];
+    }
+  }
+}
+
+template <size_t N, unsigned int Pin, unsigned int Order>
+void NeoPixelStrip<N, Pin, Order>::show()
+{
+  if (debugMode() == DebugMode::DryRun) {
+    return;
+  }
+
+  if (transport_ == nullptr) {
+    output_.show();
+    return;
+  }
+
+  while (transport_->busy()) {
+    yield();
+  }
+  transport_->send(pixels_);
+}
+
+template <size_t N, unsigned int Pin, unsigned int Order>
+void NeoPixelStrip<N, Pin, Order>::toWire(uint32_t color, uint8_t* pixel)
+{
+  pixel[R] = Adafruit_NeoPixel::gamma8(color >> 16);
+  pixel[G] = Adafruit_NeoPixel::gamma8(color >> 8);
+  pixel[B] = Adafruit_NeoPixel::gamma8(color);
+  if (BytesPerPixel == 4) {
+    pixel[W] = Adafruit_NeoPixel::gamma8(color >> 24);
+  }
+}
+
+#endif
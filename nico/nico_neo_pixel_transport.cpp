@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nico_neo_pixel_transport.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#endif
+
+//-----------------------------------------------------------------------------
+bool SimulatedTransport::begin(unsigned int /*pin*/, size_t bytesPerPixel, size_t numPixels)
+{
+  numBytes_ = bytesPerPixel * numPixels;
+  frame_ = static_cast<uint8_t*>(Arena::allocate(numBytes_, F("NeoPixel transport")));
+  if (frame_ == nullptr) {
+    return false;
+  }
+  memset(frame_, 0, numBytes_);
+  return true;
+}
+
+bool SimulatedTransport::busy()
+{
+  return (numFrames_ != 0
+    && ::micros() - startTime_ < numBytes_ * ByteDuration + LatchDuration);
+}
+
+void SimulatedTransport::send(const uint8_t* pixels)
+{
+  memcpy(frame_, pixels, numBytes_);
+  startTime_ = ::micros(); // wire timing: real time, also under a simulated Clock
+  ++numFrames_;
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+//-----------------------------------------------------------------------------
+namespace {
+  // ws2812 program from the pico-examples, 10 cycles per bit
+  const uint16_t Ws2812Instructions[] = {
+    0x6221, // out x, 1      side 0 [2]
+    0x1123, // jmp !x, 3     side 1 [1]
+    0x1400, // jmp 0         side 1 [4]
+    0xa442, // nop           side 0 [4]
+  };
+  const pio_program_t Ws2812Program = { Ws2812Instructions, 4, -1 };
+  const unsigned int CyclesPerBit = 10;
+}
+
+bool PioTransport::begin(unsigned int pin, size_t bytesPerPixel, size_t numPixels)
+{
+  bytesPerPixel_ = bytesPerPixel;
+  numPixels_ = numPixels;
+  words_ = static_cast<uint32_t*>(Arena::allocate(numPixels * sizeof(uint32_t), F("NeoPixel transport")));
+  if (words_ == nullptr) {
+    return false;
+  }
+
+  sm_ = pio_claim_unused_sm(pio_, false);
+  dma_ = dma_claim_unused_channel(false);
+  if (sm_ < 0 || dma_ < 0 || not pio_can_add_program(pio_, &Ws2812Program)) {
+    if (sm_ >= 0) {
+      pio_sm_unclaim(pio_, sm_);
+      sm_ = -1;
+    }
+    if (dma_ >= 0) {
+      dma_channel_unclaim(dma_);
+      dma_ = -1;
+    }
+    Arena::release(words_);
+    words_ = nullptr;
+    return false;
+  }
+  const uint offset = pio_add_program(pio_, &Ws2812Program);
+
+  pio_gpio_init(pio_, pin);
+  pio_sm_set_consecutive_pindirs(pio_, sm_, pin, 1, true);
+
+  pio_sm_config config = pio_get_default_sm_config();
+  sm_config_set_wrap(&config, offset, offset + 3);
+  sm_config_set_sideset(&config, 1, false, false);
+  sm_config_set_sideset_pins(&config, pin);
+  sm_config_set_out_shift(&config, false, true, 8 * bytesPerPixel);
+  sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_TX);
+  sm_config_set_clkdiv(&config, float(clock_get_hz(clk_sys)) / (800000 * CyclesPerBit));
+  pio_sm_init(pio_, sm_, offset, &config);
+  pio_sm_set_enabled(pio_, sm_, true);
+
+  dma_channel_config dmaConfig = dma_channel_get_default_config(dma_);
+  channel_config_set_transfer_data_size(&dmaConfig, DMA_SIZE_32);
+  channel_config_set_read_increment(&dmaConfig, true);
+  channel_config_set_write_increment(&dmaConfig, false);
+  channel_config_set_dreq(&dmaConfig, pio_get_dreq(pio_, sm_, true));
+  dma_channel_configure(dma_, &dmaConfig, &pio_->txf[sm_], words_, 0, false);
+  return true;
+}
+
+bool PioTransport::busy()
+{
+  if (dma_ < 0) {
+    return false;
+  }
+  // the last words are still shifted out after the DMA is done
+  const unsigned long duration = bytesPerPixel_ * numPixels_ * ByteDuration + LatchDuration;
+  return (dma_channel_is_busy(dma_)
+    || ::micros() - startTime_ < duration);
+}
+
+void PioTransport::send(const uint8_t* pixels)
+{
+  if (dma_ < 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < numPixels_; ++i) {
+    uint32_t word = 0;
+    for (size_t k = 0; k < bytesPerPixel_; ++k) {
+      word |= uint32_t(pixels[k]) << (24 - 8 * k);
+    }
+    words_[i] = word;
+    pixels += bytesPerPixel_;
+  }
+
+  startTime_ = ::micros();
+  dma_channel_set_read_addr(dma_, words_, false);
+  dma_channel_set_trans_count(dma_, numPixels_, true);
+}
+#endif
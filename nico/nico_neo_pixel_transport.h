@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NICO_NEO_PIXEL_TRANSPORT_H
+#define NICO_NEO_PIXEL_TRANSPORT_H
+
+#include "nico_util.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/pio.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Sends frames (wire layout) to the strip without blocking the caller.
+// send() copies the frame and returns right away, busy() tells whether the
+// previous frame is still being clocked out.
+class NeoPixelTransport {
+  public:
+    static const unsigned long ByteDuration = 10; // us, at 800kHz
+    static const unsigned long LatchDuration = 300; // us
+
+    virtual bool begin(unsigned int pin, size_t bytesPerPixel, size_t numPixels) = 0;
+    virtual bool busy() = 0;
+    virtual void send(const uint8_t* pixels) = 0;
+};
+
+//-----------------------------------------------------------------------------
+// No output: models the 800kHz wire timing, for benchmarks and tests.
+class SimulatedTransport : public NeoPixelTransport {
+  public:
+    virtual bool begin(unsigned int pin, size_t bytesPerPixel, size_t numPixels);
+    virtual bool busy();
+    virtual void send(const uint8_t* pixels);
+
+    const uint8_t* lastFrame() const { return frame_; }
+    unsigned long numFrames() const { return numFrames_; }
+
+  private:
+    uint8_t* frame_ = nullptr;
+    size_t numBytes_ = 0;
+    unsigned long startTime_ = 0; // us
+    unsigned long numFrames_ = 0;
+};
+
+#if defined(ARDUINO_ARCH_RP2040)
+//-----------------------------------------------------------------------------
+// RP2040: a PIO state machine generates the signal, fed by DMA.
+class PioTransport : public NeoPixelTransport {
+  public:
+    explicit PioTransport(PIO pio = pio1) : pio_(pio) {}
+
+    virtual bool begin(unsigned int pin, size_t bytesPerPixel, size_t numPixels);
+    virtual bool busy();
+    virtual void send(const uint8_t* pixels);
+
+  private:
+    PIO pio_;
+    int sm_ = -1;
+    int dma_ = -1;
+    size_t bytesPerPixel_ = 0;
+    size_t numPixels_ = 0;
+    uint32_t* words_ = nullptr; // one per pixel, left aligned
+    unsigned long startTime_ = 0; // us
+};
+#endif
+
+#endif
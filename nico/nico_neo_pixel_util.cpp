@@ -22,7 +22,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
-#include "nico_neo_pixel_util.h"
+#include "nico_neo_pixel_blend.h"
 
 //-----------------------------------------------------------------------------
 Color::Color(const Color& color, double gamma)
@@ -32,53 +32,83 @@ Color::Color(const Color& color, double gamma)
 
 void Color::add(const Color& color, double gamma)
 {
-  r_ += round(gamma * color.r_);
-  g_ += round(gamma * color.g_);
-  b_ += round(gamma * color.b_);
-  w_ += round(gamma * color.w_);
+  r_ = saturate(r_ + round(gamma * color.r_));
+  g_ = saturate(g_ + round(gamma * color.g_));
+  b_ = saturate(b_ + round(gamma * color.b_));
+  w_ = saturate(w_ + round(gamma * color.w_));
+}
+
+uint8_t Color::saturate(double val)
+{
+  return (val <= 0.0) ? 0 : (val >= 255.0) ? 255 : uint8_t(val);
+}
+
+//-----------------------------------------------------------------------------
+Layer::Layer(BlendMode blend, double opacity)
+: blend_(blend),
+  opacity_(PackedColor::toFixed(opacity))
+{
+}
+
+//-----------------------------------------------------------------------------
+uint32_t Pattern::color(size_t index) const
+{
+  Color color;
+  setColor(index, color);
+  return PackedColor::pack(color);
+}
+
+//-----------------------------------------------------------------------------
+SolidPattern::SolidPattern(const Color& color)
+: Pattern(Layer(BlendMode::AlphaOver)),
+  color_(PackedColor::pack(color))
+{
 }
 
 //-----------------------------------------------------------------------------
 BlinkPattern::BlinkPattern(const Color& color1, const Color& color2, unsigned int period)
-: color1_(color1),
-  color2_(color2),
+: Pattern(Layer(BlendMode::AlphaOver)),
+  color1_(PackedColor::pack(color1)),
+  color2_(PackedColor::pack(color2)),
   beatKeeper_(period)
 {
 }
 
 void BlinkPattern::increment()
 {
-  index_ += beatKeeper_.getNumBeats();
-  index_ %= 2;
+  time_ = beatKeeper_.elapsed();
 }
 
-void BlinkPattern::setColor(size_t /*index*/, Color& color) const
+uint32_t BlinkPattern::color(size_t /*index*/) const
 {
-  color = (index_ == 0) ? color1_ : color2_;
+  const unsigned int period = beatKeeper_.duration();
+  const bool first = (period == 0 || (time_ / period) % 2 == 0);
+  return first ? color1_ : color2_;
 }
 
 //-----------------------------------------------------------------------------
 PulsePattern::PulsePattern(unsigned int period, double minGamma)
-: period_(period),
+: Pattern(Layer(BlendMode::Multiply)),
+  period_(period),
   minGamma_(minGamma),
-  beatKeeper_(beatPeriod_) // ms
+  beatKeeper_(period)
 {
 }
 
 void PulsePattern::increment()
 {
-  if (period_ == 0) {
-    return; // safety
-  }
-
-  count_ += beatKeeper_.getNumBeats();
+  time_ = beatKeeper_.elapsed();
 }
 
-void PulsePattern::setColor(size_t /*index*/, Color& color) const
+uint32_t PulsePattern::color(size_t /*index*/) const
 {
-  const double level = (beatPeriod_ * count_) % period_;
+  if (period_ == 0) {
+    return 0xFFFFFFFF; // safety
+  }
+
+  const double level = time_ % period_;
   const double half = (double)period_ / 2;
   double gamma = (level <= half ) ? level / half : 2.0 - level / half;
   gamma = gamma * (1.0 - minGamma_) + minGamma_;
-  color = Color(color, gamma);
+  return 0x01010101 * uint32_t(round(gamma * 255));
 }
@@ -38,31 +38,66 @@ struct Color {
     
   static const Color black_;
 
-  void add(const Color& color, double gamma);
+  void add(const Color& color, double gamma); // saturating
 
   uint8_t r_ = 0;
   uint8_t g_ = 0;
   uint8_t b_ = 0;
   uint8_t w_ = 0;
+
+  private:
+    static uint8_t saturate(double val);
+};
+
+//-----------------------------------------------------------------------------
+// How an effect is composited onto the ones below it, see PackedColor::blend.
+// AlphaOver at full opacity replaces them.
+enum class BlendMode { Add, Multiply, Max, AlphaOver };
+
+struct Layer {
+  static const uint16_t Opaque = 256; // same scale as PackedColor::One
+
+  Layer(BlendMode blend = BlendMode::Add, double opacity = 1.0);
+
+  bool opaque() const { return (blend_ == BlendMode::AlphaOver && opacity_ == Opaque); }
+
+  BlendMode blend_;
+  uint16_t opacity_; // 8.8 fixed point
 };
 
 //-----------------------------------------------------------------------------
+// Patterns are functions of the time elapsed since they were created:
+// increment() samples the time, color() uses it. They are stacked as layers,
+// those below an opaque one are not evaluated.
+// Patterns written before layers implement setColor() instead of color():
+// still supported, drawn over the layers below by default.
 class Pattern {
   public:
+    Pattern() : layer_(BlendMode::AlphaOver) {}
+    explicit Pattern(const Layer& layer) : layer_(layer) {}
+
+    const Layer& layer() const { return layer_; }
+    void setLayer(const Layer& layer) { layer_ = layer; }
+    virtual bool opaque() const { return layer_.opaque(); } // covers every pixel
+
     virtual void increment() = 0;
-    virtual void setColor(size_t index, Color& color) const = 0;
+    virtual uint32_t color(size_t index) const; // see PackedColor, from setColor() by default
+    virtual void setColor(size_t /*index*/, Color& /*color*/) const {} // deprecated, override color()
+
+  private:
+    Layer layer_;
 };
 
 //-----------------------------------------------------------------------------
 class SolidPattern : public Pattern {
   public:
-    SolidPattern(const Color& color) : color_(color) {}
+    SolidPattern(const Color& color);
 
     virtual void increment() {}
-    virtual void setColor(size_t /*index*/, Color& color) const { color = color_; }
+    virtual uint32_t color(size_t /*index*/) const { return color_; }
 
   private:
-    const Color color_;
+    const uint32_t color_;
 };
 
 //-----------------------------------------------------------------------------
@@ -71,29 +106,29 @@ class BlinkPattern : public Pattern {
     BlinkPattern(const Color& color1, const Color& color2, unsigned int period); // ms
 
     virtual void increment();
-    virtual void setColor(size_t index, Color& color) const;
+    virtual uint32_t color(size_t index) const;
 
   private:
-    const Color color1_;
-    const Color color2_;
+    const uint32_t color1_;
+    const uint32_t color2_;
     BeatKeeper  beatKeeper_;
-    size_t index_ = 0;
+    unsigned long time_ = 0; // ms
 };
 
 //-----------------------------------------------------------------------------
+// Gray level, multiplies the layers below by default.
 class PulsePattern : public Pattern {
   public:
     PulsePattern(unsigned int period, double minGamma = 0.0); // ms
 
     virtual void increment();
-    virtual void setColor(size_t index, Color& color) const;
+    virtual uint32_t color(size_t index) const;
 
   private:
-    static const unsigned int beatPeriod_ = 50; // ms
     const unsigned int period_;
     const double minGamma_;
     BeatKeeper beatKeeper_;
-    size_t count_ = 0;
+    unsigned long time_ = 0; // ms
 };
 
 //-----------------------------------------------------------------------------
@@ -103,12 +138,12 @@ struct SnakeSetup {
   Direction dir_;
   size_t length_;
   double fadeFactor_;
-  unsigned int duration_; // ms
+  unsigned int duration_; // ms per pixel, the head moves smoothly in between
 };
 
 struct PulseSetup {
   Color color_;
-  unsigned int duration_; // ms
+  unsigned int duration_; // ms from off to full
 };
 
 struct RandomSetup {
@@ -118,4 +153,21 @@ struct RandomSetup {
   unsigned int duration_; // ms
 };
 
+// Spatial effects, over a PixelMap: positions and lengths in its 0..1 units.
+struct GradientSetup {
+  Color color1_;
+  Color color2_;
+  int angle_; // degrees in the x, y plane, 0 from color1 at x = 0 to color2
+  unsigned int duration_; // ms to scroll to color2 and back, 0 for still
+};
+
+struct WaveSetup {
+  Color color_;
+  double x_; // center
+  double y_;
+  double z_;
+  double wavelength_;
+  unsigned int duration_; // ms for a wavelength to travel outwards
+};
+
 #endif
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nico_triple_buffer.h"
+
+//-----------------------------------------------------------------------------
+bool TripleBuffer::init(size_t size)
+{
+  for (size_t i = 0; i < Count; ++i) {
+    buffers_[i] = static_cast<uint8_t*>(Arena::allocate(size, F("NeoPixel pipeline")));
+    if (buffers_[i] == nullptr) {
+      return false;
+    }
+    memset(buffers_[i], 0, size);
+    states_[i] = Free;
+  }
+  size_ = size;
+  return true;
+}
+
+uint8_t* TripleBuffer::acquire()
+{
+  if (writeIndex_ != Count) {
+    return buffers_[writeIndex_];
+  }
+
+  size_t index = Count;
+  while (index == Count) {
+    for (size_t i = 0; i < Count; ++i) {
+      if (states_[i] == Free) { // only left by the producer
+        states_[i] = Rendering;
+        index = i;
+        break;
+      }
+    }
+    if (index != Count) {
+      break;
+    }
+
+    // None free: one buffer at most is Showing, so there are two Ready
+    // frames. The older one is stale, the consumer only ever takes the
+    // latest, but may still be about to take it.
+    size_t stale = Count;
+    for (size_t i = 0; i < Count; ++i) {
+      if (i != latest_ && states_[i] == Ready
+          && (stale == Count || sequences_[i] < sequences_[stale])) {
+        stale = i;
+      }
+    }
+    if (stale != Count && leaveReady(states_[stale], Rendering)) {
+      index = stale;
+    }
+  }
+
+  writeIndex_ = index;
+  if (latest_ != Count && latest_ != index) {
+    // only the producer ever writes into a free buffer, the latest frame stays intact
+    memcpy(buffers_[index], buffers_[latest_], size_);
+  }
+  return buffers_[index];
+}
+
+void TripleBuffer::publish()
+{
+  if (writeIndex_ == Count) {
+    return;
+  }
+
+  sequences_[writeIndex_] = ++sequence_;
+  __sync_synchronize(); // frame contents visible before its state
+  states_[writeIndex_] = Ready;
+  latest_ = writeIndex_;
+  writeIndex_ = Count;
+}
+
+//-----------------------------------------------------------------------------
+const uint8_t* TripleBuffer::consume()
+{
+  size_t index = Count;
+  while (true) {
+    index = Count;
+    for (size_t i = 0; i < Count; ++i) {
+      if (states_[i] == Ready && sequences_[i] > consumed_
+          && (index == Count || sequences_[i] > sequences_[index])) {
+        index = i;
+      }
+    }
+    if (index == Count) {
+      return nullptr;
+    }
+    if (leaveReady(states_[index], Showing)) {
+      break;
+    }
+    // taken back by the producer as stale: a newer frame is published
+  }
+
+  consumed_ = sequences_[index];
+  readIndex_ = index;
+  return buffers_[index];
+}
+
+void TripleBuffer::release()
+{
+  if (readIndex_ == Count) {
+    return;
+  }
+  __sync_synchronize(); // done reading before the producer may reuse it
+  states_[readIndex_] = Free;
+  readIndex_ = Count;
+}
+
+//-----------------------------------------------------------------------------
+bool TripleBuffer::leaveReady(volatile uint8_t& state, State to)
+{
+#if defined(__AVR__)
+  // single core: only an interrupt can come in between
+  const uint8_t sreg = SREG;
+  cli();
+  const bool moved = (state == Ready);
+  if (moved) {
+    state = to;
+  }
+  SREG = sreg;
+  return moved;
+#else
+  uint8_t expected = Ready;
+  return __atomic_compare_exchange_n(&state, &expected, uint8_t(to), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
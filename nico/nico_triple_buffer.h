@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NICO_TRIPLE_BUFFER_H
+#define NICO_TRIPLE_BUFFER_H
+
+#include "nico_util.h"
+
+//-----------------------------------------------------------------------------
+// Lock-free handoff of frames from one producer to one consumer, e.g. from
+// the rendering core to the output core of an RP2040:
+//   producer: Free -> Rendering -> Ready, and stale Ready -> Rendering
+//   consumer: Ready -> Showing -> Free
+// Both sides move buffers out of Ready, with a compare-and-swap: the side
+// that loses scans again. The other states are only left by one side, with
+// plain stores. Stale frames are left to the producer, the consumer skips
+// the frames older than the last one it took.
+// The consumer always gets the latest published frame. The producer never
+// waits: when the consumer is behind (or not running yet), the oldest frame
+// not shown is dropped and its buffer reused.
+class TripleBuffer {
+  public:
+    static const size_t Count = 3;
+
+    bool init(size_t size); // bytes per buffer
+    size_t size() const { return size_; }
+
+    // producer
+    uint8_t* acquire(); // contents of the last published frame
+    void publish();
+    const uint8_t* latest() const { return (latest_ == Count) ? nullptr : buffers_[latest_]; }
+
+    // consumer
+    const uint8_t* consume(); // nullptr if nothing new
+    void release();
+
+  private:
+    enum State : uint8_t { Free, Rendering, Ready, Showing };
+
+    uint8_t* buffers_[Count] = { nullptr, nullptr, nullptr };
+    volatile uint8_t states_[Count] = { Free, Free, Free };
+    volatile unsigned long sequences_[Count] = { 0, 0, 0 };
+    size_t size_ = 0;
+
+    // producer side
+    size_t writeIndex_ = Count;
+    size_t latest_ = Count;
+    unsigned long sequence_ = 0;
+
+    // consumer side
+    size_t readIndex_ = Count;
+    unsigned long consumed_ = 0; // sequence
+
+    static bool leaveReady(volatile uint8_t& state, State to); // false if the other side was first
+};
+
+#endif
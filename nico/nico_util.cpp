@@ -24,15 +24,119 @@
 
 #include "nico_util.h"
 
+//-----------------------------------------------------------------------------
+bool Clock::simulated_ = false;
+unsigned long Clock::time_ = 0;
+
+unsigned long Clock::millis()
+{
+  return simulated_ ? time_ / 1000 : ::millis();
+}
+
+unsigned long Clock::micros()
+{
+  return simulated_ ? time_ : ::micros();
+}
+
+void Clock::simulate(unsigned long time)
+{
+  simulated_ = true;
+  time_ = 1000 * time;
+}
+
+void Clock::advance(unsigned long duration)
+{
+  time_ += 1000 * duration;
+}
+
+void Clock::advanceMicros(unsigned long duration)
+{
+  time_ += duration;
+}
+
+void Clock::release()
+{
+  simulated_ = false;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t Prng::state_ = 2463534242UL;
+
+void Prng::seed(uint32_t seed)
+{
+  state_ = (seed == 0) ? 2463534242UL : seed; // 0 is a fixed point
+}
+
 //-----------------------------------------------------------------------------
 void Timer::reset(unsigned int duration)
 {
-  time_ = millis() + duration;
+  time_ = Clock::millis() + duration;
 }
 
 bool Timer::elapsed() const
 {
-  return (millis() > time_);
+  return (Clock::millis() > time_);
+}
+
+//-----------------------------------------------------------------------------
+FrameGovernor::FrameGovernor(unsigned int fps, double budget)
+{
+  setTarget(fps, budget);
+}
+
+void FrameGovernor::setTarget(unsigned int fps, double budget)
+{
+  period_ = (fps == 0) ? 0 : 1000000UL / fps;
+  budget_ = period_ * budget;
+}
+
+bool FrameGovernor::due()
+{
+  const unsigned long time = Clock::micros();
+  if (not started_) {
+    started_ = true;
+    nextTime_ = time;
+    fpsTime_ = Clock::millis();
+  }
+  if (long(time - nextTime_) < 0) {
+    return false;
+  }
+
+  if (period_ != 0) {
+    const unsigned long late = (time - nextTime_) / period_;
+    dropped_ += late;
+    nextTime_ += (late + 1) * period_;
+  }
+  return true;
+}
+
+void FrameGovernor::begin()
+{
+  beginTime_ = Clock::micros();
+}
+
+void FrameGovernor::end()
+{
+  const unsigned long duration = Clock::micros() - beginTime_;
+  frameTime_ = (frameTime_ == 0) ? duration : frameTime_ + (long(duration) - long(frameTime_)) / 8;
+
+  if (budget_ != 0 && ++framesSinceChange_ >= Hysteresis) {
+    if (frameTime_ > budget_ && quality_ != Low) {
+      quality_ = Quality(quality_ - 1);
+      framesSinceChange_ = 0;
+    } else if (frameTime_ < budget_ / 2 && quality_ != High) {
+      quality_ = Quality(quality_ + 1);
+      framesSinceChange_ = 0;
+    }
+  }
+
+  ++fpsFrames_;
+  const unsigned long elapsed = Clock::millis() - fpsTime_;
+  if (elapsed >= 1000) {
+    fps_ = 1000.0 * fpsFrames_ / elapsed;
+    fpsFrames_ = 0;
+    fpsTime_ += elapsed;
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -44,7 +148,7 @@ BeatKeeper::BeatKeeper(unsigned int duration)
 void BeatKeeper::reset(unsigned int duration)
 {
   duration_ = duration;
-  startTime_ = millis();
+  startTime_ = Clock::millis();
   totalNumBeats_ = 0;
 }
 
@@ -54,7 +158,7 @@ size_t BeatKeeper::getNumBeats()
         return 0;
     }
 
-    const unsigned long time = millis();
+    const unsigned long time = Clock::millis();
     if (time < startTime_) { // rollover
         reset(duration_);
         return 0;
@@ -79,11 +183,11 @@ void TimeAveragedValue::add(double val, unsigned int halfLife)
     return;
   }
   
-  const unsigned int duration = millis() - setTime_;
+  const unsigned int duration = Clock::millis() - setTime_;
   const double factor = exp(-0.693 * duration / halfLife);
   //Console::instance_ << duration << "/" << halfLife << " " << factor << "\n";
   val_ = factor * val_ + (1 - factor) * val;
-  setTime_ = millis();
+  setTime_ = Clock::millis();
 }
 
 //-----------------------------------------------------------------------------
@@ -143,7 +247,7 @@ Console& Console::operator<<(Special special)
 {
   switch (special) {
     case Time: {
-      const double seconds = double(millis()) / 1000;
+      const double seconds = double(Clock::millis()) / 1000;
       *this << "[" << seconds;
       if (prevSeconds_ > 0) {
         const double delta = seconds - prevSeconds_;
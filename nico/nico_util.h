@@ -25,12 +25,54 @@
 #ifndef NICO_UTIL_H
 #define NICO_UTIL_H
 
+#include "nico_memory.h"
+
 #include <Arduino.h>
 #include <Array.h>
 
 //-----------------------------------------------------------------------------
 enum class DebugMode { None, Print, DryRun };
 
+//-----------------------------------------------------------------------------
+// Time source of the library. Can be frozen and stepped manually so that
+// effects run deterministically (e.g. for golden frame comparison).
+class Clock {
+  public:
+    static unsigned long millis();
+    static unsigned long micros();
+
+    static void simulate(unsigned long time); // ms
+    static void advance(unsigned long duration); // ms
+    static void advanceMicros(unsigned long duration);
+    static void release();
+    static bool simulated() { return simulated_; }
+
+  private:
+    static bool simulated_;
+    static unsigned long time_; // us
+};
+
+//-----------------------------------------------------------------------------
+// xorshift32, shared by the effects: a few shifts per number instead of the
+// rand() and division behind random(). Seeded for reproducible sequences.
+class Prng {
+  public:
+    static void seed(uint32_t seed);
+
+    static uint32_t next()
+    {
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 17;
+      state_ ^= state_ << 5;
+      return state_;
+    }
+
+    static uint32_t below(uint32_t n) { return ((next() >> 16) * n) >> 16; } // [0, n), n <= 65536
+
+  private:
+    static uint32_t state_;
+};
+
 //-----------------------------------------------------------------------------
 class Timer {
   public:
@@ -48,6 +90,8 @@ class BeatKeeper {
    
     void reset(unsigned int duration); // ms
     size_t getNumBeats();
+    unsigned int duration() const { return duration_; } // ms
+    unsigned long elapsed() const { return Clock::millis() - startTime_; } // ms since reset
 
   private:
     unsigned int duration_ = 0;
@@ -55,6 +99,44 @@ class BeatKeeper {
     size_t totalNumBeats_ = 0;
 };
 
+//-----------------------------------------------------------------------------
+// Paces frames to a target rate and measures their cost (begin() to end()).
+// Late frames are dropped rather than caught up. When frames take more than
+// their budget, a part of the frame period, the quality is lowered; it is
+// raised again once they take less than half of it.
+class FrameGovernor {
+  public:
+    enum Quality { Low, Medium, High };
+
+    explicit FrameGovernor(unsigned int fps = 50, double budget = 0.5);
+
+    void setTarget(unsigned int fps, double budget);
+    bool due(); // once per frame period
+    void begin();
+    void end();
+
+    Quality quality() const { return quality_; }
+    double fps() const { return fps_; } // achieved, over the last second
+    unsigned long frameTime() const { return frameTime_; } // us, averaged
+    unsigned long dropped() const { return dropped_; } // frames
+
+  private:
+    static const unsigned int Hysteresis = 8; // frames between quality changes
+
+    unsigned long period_ = 0; // us
+    unsigned long budget_ = 0; // us
+    unsigned long nextTime_ = 0; // us
+    bool started_ = false;
+    unsigned long beginTime_ = 0; // us
+    unsigned long frameTime_ = 0;
+    Quality quality_ = High;
+    unsigned int framesSinceChange_ = 0;
+    unsigned long dropped_ = 0;
+    unsigned long fpsTime_ = 0; // ms
+    unsigned int fpsFrames_ = 0;
+    double fps_ = 0.0;
+};
+
 //-----------------------------------------------------------------------------
 class TimeAveragedValue {
   public:
@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nico_frame_stream.h"
+
+//-----------------------------------------------------------------------------
+FrameStreamPlayer::FrameStreamPlayer(SdFat& sd, NeoPixelRawArray& array, DebugMode debugMode)
+: Base(debugMode),
+  sd_(sd),
+  array_(array)
+{
+}
+
+FrameStreamPlayer::~FrameStreamPlayer()
+{
+  close();
+}
+
+bool FrameStreamPlayer::open(const char* filename)
+{
+  close();
+  if (not file_.open(sd_.vwd(), filename, O_READ)) {
+    Console::instance_ << F("Cannot open ") << filename << "\n";
+    return false;
+  }
+
+  uint8_t buffer[FrameStream::HeaderSize];
+  if (file_.read(buffer, sizeof(buffer)) != int(sizeof(buffer))
+      || not header_.read(buffer)
+      || header_.bytesPerPixel_ != array_.bytesPerPixel()
+      || header_.numPixels_ != array_.size()
+      || header_.numFrames_ == 0) {
+    Console::instance_ << filename << F(": not an animation of this array\n");
+    close();
+    return false;
+  }
+
+  const size_t payloadSize = header_.maxPayloadSize_;
+  for (size_t k = 0; k < 2; ++k) {
+    buffers_[k].data_ = static_cast<uint8_t*>(Arena::allocate(payloadSize, F("FrameStreamPlayer")));
+  }
+  // frames are decoded as deltas on the previous one, which the array may
+  // not keep: swapped out when pipelined, dimmed by the power limit
+  const bool ownPixels = array_.pipelined() || array_.powerBudget() != 0;
+  if (ownPixels) {
+    pixels_ = static_cast<uint8_t*>(Arena::allocate(array_.numBytes(), F("FrameStreamPlayer")));
+  }
+  if (buffers_[0].data_ == nullptr || buffers_[1].data_ == nullptr || (ownPixels && pixels_ == nullptr)) {
+    Console::instance_ << F("not enough memory for frame stream\n");
+    close();
+    return false;
+  }
+
+  if (debugMode() != DebugMode::None) {
+    Console::instance_ << Console::Time << F("animation ") << filename << F(": ")
+      << (unsigned long)header_.numFrames_ << F(" frames\n");
+  }
+  nextFrame_ = 0;
+  nextRead_ = 0;
+  resetBuffers();
+  return true;
+}
+
+void FrameStreamPlayer::close()
+{
+  playing_ = false;
+  file_.close();
+  Arena::release(pixels_);
+  Arena::release(buffers_[1].data_);
+  Arena::release(buffers_[0].data_);
+  pixels_ = nullptr;
+  buffers_[0] = Buffer();
+  buffers_[1] = Buffer();
+}
+
+void FrameStreamPlayer::play(unsigned long startTime)
+{
+  if (not isOpen()) {
+    return;
+  }
+  startTime_ = startTime;
+  playing_ = true;
+  skipped_ = 0;
+  underrunFrame_ = 0;
+  underruns_ = 0;
+  if (nextFrame_ != 0) {
+    seekKeyFrame(0);
+  }
+}
+
+bool FrameStreamPlayer::seek(size_t frame)
+{
+  if (not isOpen() || frame >= header_.numFrames_ || not seekKeyFrame(frame)) {
+    return false;
+  }
+  startTime_ = Clock::millis() - (unsigned long)(double(frame) * header_.framePeriod_ / 1000);
+  return true;
+}
+
+bool FrameStreamPlayer::seekKeyFrame(size_t frame)
+{
+  // the frames in between are applied by update()
+  const size_t key = frame / header_.keyFrameInterval_;
+  uint8_t buffer[4];
+  if (not file_.seekSet(header_.indexOffset_ + 4 * key)
+      || file_.read(buffer, sizeof(buffer)) != int(sizeof(buffer))
+      || not file_.seekSet(FrameStream::read32(buffer))) {
+    Console::instance_ << F("frame stream index error\n");
+    playing_ = false;
+    return false;
+  }
+  nextFrame_ = key * header_.keyFrameInterval_;
+  nextRead_ = nextFrame_;
+  resetBuffers();
+  return true;
+}
+
+size_t FrameStreamPlayer::dueFrame() const
+{
+  const unsigned long elapsed = Clock::millis() - startTime_;
+  if (long(elapsed) < 0) {
+    return 0; // not started
+  }
+  return size_t(elapsed * 1000.0 / header_.framePeriod_);
+}
+
+void FrameStreamPlayer::update()
+{
+  if (not playing_) {
+    return;
+  }
+
+  budget_ = ReadSize;
+  readAhead();
+
+  size_t due = dueFrame();
+  if (due >= header_.numFrames_) {
+    if (nextFrame_ >= header_.numFrames_) {
+      playing_ = false;
+      return;
+    }
+    due = header_.numFrames_ - 1;
+  }
+  if (due + 1 < nextFrame_ || due >= nextFrame_ + header_.keyFrameInterval_) {
+    // timeline moved back, or too far behind to catch up frame by frame
+    if (not seekKeyFrame(due)) {
+      return;
+    }
+    readAhead();
+  }
+  if (due < nextFrame_) {
+    return; // shown
+  }
+
+  uint8_t* pixels = (pixels_ != nullptr) ? pixels_ : array_.frame();
+  bool decoded = false;
+  while (nextFrame_ <= due) {
+    if (numReady_ == 0) {
+      readAhead(); // what is left of the budget
+    }
+    if (numReady_ == 0) {
+      if (underrunFrame_ != nextFrame_ + 1) {
+        underrunFrame_ = nextFrame_ + 1;
+        ++underruns_;
+      }
+      break;
+    }
+    if (not decodeNext(pixels)) {
+      Console::instance_ << F("frame stream error at frame ") << (unsigned long)nextFrame_ << "\n";
+      playing_ = false;
+      return;
+    }
+    if (nextFrame_ <= due) {
+      ++skipped_;
+    }
+    decoded = true;
+  }
+
+  if (decoded) {
+    show();
+  }
+}
+
+void FrameStreamPlayer::resetBuffers()
+{
+  first_ = 0;
+  numReady_ = 0;
+  buffers_[0].sized_ = false;
+  buffers_[1].sized_ = false;
+}
+
+void FrameStreamPlayer::readAhead()
+{
+  while (numReady_ < 2 && nextRead_ < header_.numFrames_ && budget_ != 0) {
+    Buffer& buffer = buffers_[(first_ + numReady_) % 2];
+    if (not buffer.sized_) {
+      uint8_t size[2];
+      if (file_.read(size, sizeof(size)) != int(sizeof(size))) {
+        return;
+      }
+      buffer.size_ = FrameStream::read16(size);
+      buffer.filled_ = 0;
+      buffer.sized_ = true;
+      if (buffer.size_ > header_.maxPayloadSize_) {
+        Console::instance_ << F("frame stream error at frame ") << (unsigned long)nextRead_ << "\n";
+        playing_ = false;
+        return;
+      }
+    }
+
+    const size_t remaining = buffer.size_ - buffer.filled_;
+    const size_t size = (remaining < budget_) ? remaining : budget_;
+    if (size != 0) {
+      const int read = file_.read(buffer.data_ + buffer.filled_, size);
+      if (read <= 0) {
+        return;
+      }
+      buffer.filled_ += read;
+      budget_ -= read;
+    }
+    if (buffer.filled_ >= buffer.size_) {
+      ++numReady_;
+      ++nextRead_;
+    }
+  }
+}
+
+bool FrameStreamPlayer::decodeNext(uint8_t* pixels)
+{
+  Buffer& buffer = buffers_[first_];
+  const bool valid = FrameStream::decode(buffer.data_, buffer.size_, pixels, header_.numPixels_, header_.bytesPerPixel_);
+  buffer.sized_ = false;
+  first_ = (first_ + 1) % 2;
+  --numReady_;
+  ++nextFrame_;
+  return valid;
+}
+
+void FrameStreamPlayer::show()
+{
+  if (pixels_ != nullptr) {
+    memcpy(array_.frame(), pixels_, array_.numBytes());
+    array_.dim(array_.frame(), array_.numBytes());
+  }
+  array_.show();
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NICO_FRAME_STREAM_H
+#define NICO_FRAME_STREAM_H
+
+#include "nico_config.h"
+#include "nico_frame_stream_format.h"
+#include "nico_neo_pixel.h"
+
+#include <SdFat.h>
+
+//-----------------------------------------------------------------------------
+// Plays a prerendered animation (see nico_frame_stream_format.h) from the SD
+// card: update() reads the next frames ahead into two buffers, a bounded
+// number of bytes per call, and shows each frame when due. The cost per
+// frame is a copy of the changed pixels, whatever rendered them.
+// Frames are changes to the previous one: nothing else may draw on the
+// array while playing. Late frames are applied without being shown; when
+// too late, playback skips to a key frame.
+class FrameStreamPlayer : public Base {
+  public:
+    static const size_t ReadSize = NICO_FRAME_STREAM_READ_SIZE;
+
+    FrameStreamPlayer(SdFat& sd, NeoPixelRawArray& array, DebugMode debugMode);
+    ~FrameStreamPlayer();
+
+    bool open(const char* filename); // false if not an animation of this array, after setPowerBudget()
+    void close();
+    bool isOpen() const { return file_.isOpen(); }
+    const FrameStream::Header& header() const { return header_; }
+
+    void play() { play(Clock::millis()); }
+    void play(unsigned long startTime); // ms, Clock time of the first frame
+    void sync(unsigned long startTime) { startTime_ = startTime; } // e.g. MP3Player::trackStartTime()
+    void stop() { playing_ = false; }
+    bool isPlaying() const { return playing_; }
+    bool seek(size_t frame); // moves the timeline
+    void update();
+
+    size_t frame() const { return nextFrame_ - 1; } // last shown
+    unsigned long skipped() const { return skipped_; } // frames applied late, not shown
+    unsigned long underruns() const { return underruns_; } // frames not read in time
+
+  private:
+    struct Buffer {
+      uint8_t* data_ = nullptr;
+      size_t size_ = 0; // payload, once known
+      size_t filled_ = 0;
+      bool sized_ = false;
+    };
+
+    SdFat& sd_;
+    NeoPixelRawArray& array_;
+    SdFile file_;
+    FrameStream::Header header_;
+    Buffer buffers_[2]; // frames read ahead
+    size_t first_ = 0; // oldest buffer
+    size_t numReady_ = 0;
+    uint8_t* pixels_ = nullptr; // pipelined or power limited arrays only, see open()
+    bool playing_ = false;
+    unsigned long startTime_ = 0; // ms
+    size_t nextFrame_ = 0; // to decode
+    size_t nextRead_ = 0;
+    size_t budget_ = 0; // bytes left to read in this update()
+    unsigned long skipped_ = 0;
+    unsigned long underruns_ = 0;
+    size_t underrunFrame_ = 0; // counted once
+
+    size_t dueFrame() const;
+    bool seekKeyFrame(size_t frame); // before frame
+    void resetBuffers();
+    void readAhead();
+    bool decodeNext(uint8_t* pixels);
+    void show();
+};
+
+#endif
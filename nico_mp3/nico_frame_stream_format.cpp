@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nico_frame_stream_format.h"
+
+#include <string.h>
+
+namespace {
+  const char Magic[4] = { 'N', 'F', 'S', 'T' };
+
+  bool samePixel(const uint8_t* a, const uint8_t* b, size_t bytesPerPixel)
+  {
+    return (memcmp(a, b, bytesPerPixel) == 0);
+  }
+}
+
+//-----------------------------------------------------------------------------
+uint16_t FrameStream::read16(const uint8_t* buffer)
+{
+  return buffer[0] | (uint16_t(buffer[1]) << 8);
+}
+
+uint32_t FrameStream::read32(const uint8_t* buffer)
+{
+  return read16(buffer) | (uint32_t(read16(buffer + 2)) << 16);
+}
+
+void FrameStream::write16(uint8_t* buffer, uint16_t val)
+{
+  buffer[0] = uint8_t(val);
+  buffer[1] = uint8_t(val >> 8);
+}
+
+void FrameStream::write32(uint8_t* buffer, uint32_t val)
+{
+  write16(buffer, uint16_t(val));
+  write16(buffer + 2, uint16_t(val >> 16));
+}
+
+//-----------------------------------------------------------------------------
+bool FrameStream::Header::read(const uint8_t* buffer)
+{
+  if (memcmp(buffer, Magic, sizeof(Magic)) != 0 || buffer[4] != Version) {
+    return false;
+  }
+  bytesPerPixel_ = buffer[5];
+  numPixels_ = read16(buffer + 6);
+  numFrames_ = read32(buffer + 8);
+  framePeriod_ = read32(buffer + 12);
+  keyFrameInterval_ = read16(buffer + 16);
+  maxPayloadSize_ = read16(buffer + 18);
+  indexOffset_ = read32(buffer + 20);
+  audioTrack_ = read16(buffer + 24);
+  return (bytesPerPixel_ >= MinBytesPerPixel && framePeriod_ != 0 && keyFrameInterval_ != 0);
+}
+
+void FrameStream::Header::write(uint8_t* buffer) const
+{
+  memset(buffer, 0, HeaderSize);
+  memcpy(buffer, Magic, sizeof(Magic));
+  buffer[4] = Version;
+  buffer[5] = bytesPerPixel_;
+  write16(buffer + 6, numPixels_);
+  write32(buffer + 8, numFrames_);
+  write32(buffer + 12, framePeriod_);
+  write16(buffer + 16, keyFrameInterval_);
+  write16(buffer + 18, maxPayloadSize_);
+  write32(buffer + 20, indexOffset_);
+  write16(buffer + 24, audioTrack_);
+}
+
+//-----------------------------------------------------------------------------
+size_t FrameStream::maxPayloadSize(size_t numPixels, size_t bytesPerPixel)
+{
+  // all literal
+  return numPixels * bytesPerPixel + (numPixels + MaxRun - 1) / MaxRun;
+}
+
+size_t FrameStream::encode(const uint8_t* frame, const uint8_t* previous, size_t numPixels, size_t bytesPerPixel, uint8_t* payload)
+{
+  const size_t n = bytesPerPixel;
+  uint8_t* out = payload;
+  uint8_t* end = payload; // trailing skips are left out
+  size_t i = 0;
+  while (i < numPixels) {
+    // unchanged pixels
+    size_t run = 0;
+    while (previous != nullptr && i + run < numPixels && run < MaxRun
+           && samePixel(frame + (i + run) * n, previous + (i + run) * n, n)) {
+      ++run;
+    }
+    if (run != 0) {
+      *out++ = Skip | (run - 1);
+      i += run;
+      continue;
+    }
+
+    // same pixel repeated
+    run = 1;
+    while (i + run < numPixels && run < MaxRun && samePixel(frame + (i + run) * n, frame + i * n, n)) {
+      ++run;
+    }
+    if (run > 1) {
+      *out++ = Repeat | (run - 1);
+      memcpy(out, frame + i * n, n);
+      out += n;
+      end = out;
+      i += run;
+      continue;
+    }
+
+    // up to the next run of either kind
+    run = 1;
+    while (i + run < numPixels && run < MaxRun) {
+      const uint8_t* pixel = frame + (i + run) * n;
+      if ((previous != nullptr && samePixel(pixel, previous + (i + run) * n, n))
+          || (i + run + 1 < numPixels && samePixel(pixel, pixel + n, n))) {
+        break;
+      }
+      ++run;
+    }
+    *out++ = Literal | (run - 1);
+    memcpy(out, frame + i * n, run * n);
+    out += run * n;
+    end = out;
+    i += run;
+  }
+  return end - payload;
+}
+
+bool FrameStream::decode(const uint8_t* payload, size_t size, uint8_t* frame, size_t numPixels, size_t bytesPerPixel)
+{
+  const size_t n = bytesPerPixel;
+  const uint8_t* end = payload + size;
+  size_t i = 0;
+  while (payload < end) {
+    const uint8_t op = *payload & 0xC0;
+    const size_t run = (*payload & 0x3F) + 1;
+    ++payload;
+    if (i + run > numPixels) {
+      return false;
+    }
+
+    switch (op) {
+      case Skip:
+        break;
+      case Literal:
+        if (size_t(end - payload) < run * n) {
+          return false;
+        }
+        memcpy(frame + i * n, payload, run * n);
+        payload += run * n;
+        break;
+      case Repeat:
+        if (size_t(end - payload) < n) {
+          return false;
+        }
+        for (size_t k = 0; k < run; ++k) {
+          memcpy(frame + (i + k) * n, payload, n);
+        }
+        payload += n;
+        break;
+      default:
+        return false;
+    }
+    i += run;
+  }
+  return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NICO_FRAME_STREAM_FORMAT_H
+#define NICO_FRAME_STREAM_FORMAT_H
+
+// No Arduino dependency: also built by the host tools.
+#include <stddef.h>
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+// Prerendered NeoPixel animation, frames in the wire layout of the strip:
+//   header: 'N' 'F' 'S' 'T', version, bytes per pixel, number of pixels
+//     (uint16), number of frames (uint32), frame period (uint32, us), key
+//     frame interval (uint16), largest frame payload (uint16), index offset
+//     (uint32), audio track (uint16, 0 for none), 0 up to HeaderSize
+//   frame: payload size (uint16), payload
+//   index: offset of every key frame (uint32), frames 0, interval, ...
+// Integers are little endian.
+// A payload is a sequence of operations on the previous frame, each a byte
+// with the operation in the 2 high bits and the number of pixels minus 1 in
+// the others: Skip leaves pixels unchanged, Literal is followed by the
+// pixels, Repeat by one pixel set to all of them. Key frames do not skip,
+// so that playback can start from them.
+namespace FrameStream {
+  const size_t HeaderSize = 32;
+  const uint8_t Version = 1;
+  const size_t MaxRun = 64; // pixels per operation
+  const size_t MinBytesPerPixel = 3; // RGB, maxPayloadSize() is no bound below
+
+  enum Op { Skip = 0x00, Literal = 0x40, Repeat = 0x80 };
+
+  struct Header {
+    uint8_t bytesPerPixel_ = 0;
+    uint16_t numPixels_ = 0;
+    uint32_t numFrames_ = 0;
+    uint32_t framePeriod_ = 0; // us
+    uint16_t keyFrameInterval_ = 0;
+    uint16_t maxPayloadSize_ = 0;
+    uint32_t indexOffset_ = 0; // bytes from the start of the file
+    uint16_t audioTrack_ = 0; // see TrackIndex
+
+    bool read(const uint8_t* buffer); // HeaderSize bytes, false if not a stream
+    void write(uint8_t* buffer) const;
+  };
+
+  // Largest payload of a frame, bytesPerPixel >= MinBytesPerPixel.
+  size_t maxPayloadSize(size_t numPixels, size_t bytesPerPixel);
+  // Payload size, previous is nullptr for a key frame.
+  size_t encode(const uint8_t* frame, const uint8_t* previous, size_t numPixels, size_t bytesPerPixel, uint8_t* payload);
+  // Applies the payload to the previous frame, false if it does not fit.
+  bool decode(const uint8_t* payload, size_t size, uint8_t* frame, size_t numPixels, size_t bytesPerPixel);
+
+  uint16_t read16(const uint8_t* buffer);
+  uint32_t read32(const uint8_t* buffer);
+  void write16(uint8_t* buffer, uint16_t val);
+  void write32(uint8_t* buffer, uint32_t val);
+}
+
+#endif
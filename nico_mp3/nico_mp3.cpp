@@ -24,86 +24,554 @@
 
 #include "nico_mp3.h"
 
-#include <FreeStack.h>
-#include <SPI.h>
 
 //-----------------------------------------------------------------------------
-MP3Player::MP3Player(SdFat& sd, DebugMode debugMode)
+void StreamBuffer::write(const uint8_t* data, size_t size)
+{
+  size_t head = head_;
+  for (size_t i = 0; i < size; ++i, ++head) {
+    data_[head & (Size - 1)] = data[i];
+  }
+
+#if defined(__AVR__)
+  const uint8_t sreg = SREG;
+  cli();
+  head_ = head;
+  SREG = sreg;
+#else
+  head_ = head;
+#endif
+}
+
+const uint8_t* StreamBuffer::peek(size_t& size) const
+{
+  const size_t tail = load(tail_);
+  const size_t offset = tail & (Size - 1);
+  size = load(head_) - tail;
+  if (offset + size > Size) {
+    size = Size - offset;
+  }
+  return &data_[offset];
+}
+
+void StreamBuffer::consume(size_t size)
+{
+#if defined(__AVR__)
+  const uint8_t sreg = SREG;
+  cli();
+  tail_ += size;
+  SREG = sreg;
+#else
+  tail_ += size;
+#endif
+}
+
+size_t StreamBuffer::load(const volatile size_t& index)
+{
+#if defined(__AVR__)
+  // 16 bit: not atomic
+  const uint8_t sreg = SREG;
+  cli();
+  const size_t val = index;
+  SREG = sreg;
+  return val;
+#else
+  return index;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+MP3Player* MP3Player::interruptInstance_ = nullptr;
+
+MP3Player::MP3Player(MP3Storage& storage, MP3Decoder& decoder, DebugMode debugMode, RefillMode refillMode)
 : Base(debugMode),
-  sd_(sd)
+  storage_(storage),
+  decoder_(decoder),
+  refillMode_(refillMode)
 {
+  Arena::account(F("MP3Player"), sizeof(MP3Player));
 }
 
-void MP3Player::init()
+MP3Player::~MP3Player()
 {
-  if (debugMode() != DebugMode::None) {
-    Console::instance_ << "\n" << F("F_CPU = ") << F_CPU << "\n";
-    Console::instance_ << F("Free RAM = ") << FreeStack() << F(" Should be a base line of 1028, on ATmega328 when using INTx\n");
+  if (interruptInstance_ == this) {
+    interruptInstance_ = nullptr;
+  }
+  for (size_t i = 0; i < clips_.size(); ++i) {
+    Arena::release(clips_[i].head_);
   }
+}
 
+bool MP3Player::init(bool persistIndex)
+{
   if (debugMode() == DebugMode::DryRun) {
-    return;
+    started_ = true;
+    return true;
   }
 
-  // init SD card
-  if (not sd_.begin(SD_SEL, SPI_FULL_SPEED)) {
-    sd_.initErrorHalt();
+  if (not storage_.begin(persistIndex)) {
+    Console::instance_ << F("MP3 storage did not start\n");
+    return false;
+  }
+  if (debugMode() != DebugMode::None) {
+    Console::instance_ << F("Tracks indexed: ") << storage_.numTracks() << "\n";
   }
-  if (not sd_.chdir("/")) {
-    sd_.errorHalt("sd.chdir");
+
+  if (not decoder_.begin()) {
+    Console::instance_ << F("MP3 decoder did not start\n");
+    return false;
   }
 
-  // init MP3 player
-  const uint8_t res = player_.begin();
-  if (res != 0) {
-    Console::instance_ << F("Error code: ") << res << F(" when trying to start MP3 player\n");
+  if (refillMode_ == RefillMode::Interrupt) {
+    interruptInstance_ = this;
+    if (not decoder_.attachInterrupt(onDataRequest)) {
+      interruptInstance_ = nullptr;
+      refillMode_ = RefillMode::Polled;
+      Console::instance_ << F("MP3 decoder without interrupt, polling\n");
+    }
   }
+
+  started_ = true;
+  return true;
 }
 
 void MP3Player::clear()
 {
-  filename_ = nullptr;
+  queue_.clear();
+  timerStarted_ = false;
+  storage_.close(nextFile_);
 }
 
 void MP3Player::setNext(const char* filename, unsigned int duration)
 {
-  filename_ = filename;
-  if (filename_ == nullptr) {
+  if (filename == nullptr) {
+    clear();
     return;
   }
 
+  Track track;
+  track.filename_ = filename;
+  setNext(track, duration);
+}
+
+void MP3Player::setNextTrack(uint16_t id, unsigned int duration)
+{
+  Track track;
+  track.id_ = id;
+  setNext(track, duration);
+}
+
+void MP3Player::setNext(const Track& track, unsigned int duration)
+{
+  clear();
+  enqueue(track);
   timer_.reset(duration);
+  timerStarted_ = true;
 
   if (debugMode() != DebugMode::None) {
     const double seconds = double(duration) / 1000; 
-    Console::instance_ << Console::Time << F("next play ") << filename << F(" in ") << seconds << F("s\n");
+    Console::instance_ << Console::Time << F("next play ");
+    print(track);
+    Console::instance_ << F(" in ") << seconds << F("s\n");
+  }
+}
+
+bool MP3Player::enqueue(const char* filename, unsigned int delay)
+{
+  if (filename == nullptr) {
+    return false;
+  }
+
+  Track track;
+  track.filename_ = filename;
+  track.delay_ = delay;
+  return enqueue(track);
+}
+
+bool MP3Player::enqueueTrack(uint16_t id, unsigned int delay)
+{
+  if (debugMode() != DebugMode::DryRun
+      && not storage_.hasTrack(id)) {
+    Console::instance_ << F("Unknown track ") << (unsigned int)id << "\n";
+    return false;
   }
+
+  Track track;
+  track.id_ = id;
+  track.delay_ = delay;
+  return enqueue(track);
+}
+
+bool MP3Player::enqueue(const Track& track)
+{
+  if (queue_.full()) {
+    return false;
+  }
+  queue_.push_back(track);
+  return true;
 }
 
-bool MP3Player::isPlaying()
+bool MP3Player::open(const Track& track, size_t slot)
 {
-  return (debugMode() != DebugMode::DryRun
-    && player_.isPlaying());
+  if (track.filename_ != nullptr) {
+    return storage_.open(slot, track.filename_);
+  }
+  return storage_.open(slot, track.id_);
+}
+
+void MP3Player::print(const Track& track) const
+{
+  if (track.filename_ != nullptr) {
+    Console::instance_ << "'" << track.filename_ << "'";
+  } else {
+    Console::instance_ << F("track ") << (unsigned int)track.id_;
+  }
+}
+
+bool MP3Player::isPlaying() const
+{
+  return (storage_.isOpen(file_) || clip_ != nullptr || chunkSize_ != 0 || endFillSize_ != 0
+    || buffer_.available() != 0);
 }
 
 void MP3Player::update()
 {
-  if (filename_ == nullptr
-      || not timer_.elapsed()
-      || isPlaying()) {
+  if (not started_) {
+    return;
+  }
+  if (debugMode() == DebugMode::DryRun) {
+    // tracks end as soon as they start
+    startNext();
+    return;
+  }
+
+  prefetch();
+  readAhead();
+  streaming_ = (storage_.isOpen(file_) || clip_ != nullptr);
+
+  // in interrupt mode, restart the feeding if the buffer had run dry
+  drainFromLoop();
+}
+
+bool MP3Player::due()
+{
+  if (queue_.empty()) {
+    return false;
+  }
+
+  if (not timerStarted_) {
+    if (queue_[0].delay_ == 0) {
+      return true;
+    }
+    timer_.reset(queue_[0].delay_);
+    timerStarted_ = true;
+  }
+  return timer_.elapsed();
+}
+
+void MP3Player::prefetch()
+{
+  if (storage_.isOpen(nextFile_) || queue_.empty()) {
     return;
   }
 
+  // opening may walk the directory: do it before the current track ends
+  if (not open(queue_[0], nextFile_)) {
+    Console::instance_ << F("Cannot open ");
+    print(queue_[0]);
+    Console::instance_ << "\n";
+    queue_.remove(0);
+    timerStarted_ = false;
+    return;
+  }
+
+  const int size = storage_.read(nextFile_, nextChunk_, ChunkSize);
+  nextChunkSize_ = (size > 0) ? size : 0;
+}
+
+bool MP3Player::startNext()
+{
+  if (storage_.isOpen(file_)) {
+    return false;
+  }
+
+  // only a prefetched track is dequeued: tracks that cannot be opened are
+  // dropped by prefetch() until one can
+  if (debugMode() != DebugMode::DryRun) {
+    while (not storage_.isOpen(nextFile_) && not queue_.empty()) {
+      prefetch();
+    }
+    if (not storage_.isOpen(nextFile_)) {
+      return false;
+    }
+  }
+
+  if (not due()) {
+    return false;
+  }
+
+  track_ = queue_[0];
+  queue_.remove(0);
+  timerStarted_ = false;
+  if (loop_) {
+    enqueue(track_);
+  }
+
   if (debugMode() != DebugMode::None) {
-    Console::instance_ << Console::Time << F("play '") << filename_ << F("'\n");
+    Console::instance_ << Console::Time << F("play ");
+    print(track_);
+    Console::instance_ << "\n";
+  }
+
+  if (debugMode() == DebugMode::DryRun) {
+    trackStartTime_ = Clock::millis();
+    return false;
+  }
+
+  // no end fill between tracks: the decoder sees one continuous stream
+  const size_t file = file_;
+  file_ = nextFile_;
+  nextFile_ = file;
+  memcpy(chunk_, nextChunk_, nextChunkSize_);
+  chunkSize_ = nextChunkSize_;
+  endFillSize_ = 0;
+  trackStart_ = buffer_.written();
+  trackStarting_ = true;
+  return true;
+}
+
+bool MP3Player::fillChunk()
+{
+  if (clip_ != nullptr) {
+    if (fillClipChunk()) {
+      return true;
+    }
+    clip_ = nullptr;
+    storage_.close(MP3Storage::Clip);
+    if (resume_ && storage_.isOpen(file_)) {
+      storage_.seek(file_, resumePosition_);
+    } else {
+      storage_.close(file_);
+      endFillSize_ = EndFillSize;
+    }
+  }
+
+  if (storage_.isOpen(file_)) {
+    const int size = storage_.read(file_, chunk_, ChunkSize);
+    if (size > 0) {
+      chunkSize_ = size;
+      return true;
+    }
+    storage_.close(file_);
+    endFillSize_ = EndFillSize;
+  }
+
+  prefetch();
+  if (startNext()) {
+    return true;
+  }
+
+  if (endFillSize_ != 0) {
+    chunkSize_ = (endFillSize_ < ChunkSize) ? endFillSize_ : ChunkSize;
+    memset(chunk_, 0, chunkSize_);
+    endFillSize_ -= chunkSize_;
+    return true;
   }
+  return false;
+}
 
+void MP3Player::readAhead()
+{
+  while (buffer_.free() >= ChunkSize) {
+    if (chunkSize_ == 0 && not fillChunk()) {
+      return;
+    }
+    buffer_.write(chunk_, chunkSize_);
+    chunkSize_ = 0;
+  }
+}
+
+int MP3Player::preload(const char* filename, size_t headSize)
+{
+  Track track;
+  track.filename_ = filename;
+  return preload(track, headSize);
+}
+
+int MP3Player::preloadTrack(uint16_t id, size_t headSize)
+{
+  Track track;
+  track.id_ = id;
+  return preload(track, headSize);
+}
+
+int MP3Player::preload(const Track& track, size_t headSize)
+{
+  if (not started_ || clips_.full()) {
+    return -1;
+  }
+
+  Clip clip;
+  clip.track_ = track;
   if (debugMode() != DebugMode::DryRun) {
-    const uint8_t res = player_.playMP3((char*)filename_);
-    if(res != 0) {
-      Console::instance_ << F("Error code: ") << res << F(" when trying to play track\n");
+    const size_t slot = MP3Storage::Preload;
+    if (not open(track, slot)) {
+      Console::instance_ << F("Cannot open ");
+      print(track);
+      Console::instance_ << "\n";
+      return -1;
+    }
+
+    clip.size_ = storage_.size(slot);
+    clip.headSize_ = (clip.size_ < headSize) ? clip.size_ : headSize;
+    clip.head_ = static_cast<uint8_t*>(Arena::allocate(clip.headSize_, F("MP3 clips")));
+    const bool ok = (clip.head_ != nullptr
+      && storage_.read(slot, clip.head_, clip.headSize_) == int(clip.headSize_));
+    storage_.close(slot);
+    if (not ok) {
+      Arena::release(clip.head_);
+      Console::instance_ << F("Cannot preload ");
+      print(track);
+      Console::instance_ << "\n";
+      return -1;
+    }
+  }
+
+  clips_.push_back(clip);
+  return clips_.size() - 1;
+}
+
+bool MP3Player::trigger(size_t clip, bool resume)
+{
+  if (not started_ || clip >= clips_.size()) {
+    return false;
+  }
+
+  if (debugMode() != DebugMode::None) {
+    Console::instance_ << Console::Time << F("trigger ");
+    print(clips_[clip].track_);
+    Console::instance_ << "\n";
+  }
+
+  if (debugMode() == DebugMode::DryRun) {
+    return true;
+  }
+
+  triggerTime_ = Clock::micros();
+  triggerLatency_ = 0;
+  draining_ = true; // keep the interrupt away
+
+  // position of the first byte of the track not yet sent to the decoder
+  resume_ = resume && storage_.isOpen(file_);
+  if (resume_ && clip_ == nullptr) {
+    const uint32_t pending = buffer_.available() + chunkSize_;
+    const uint32_t position = storage_.position(file_);
+    resumePosition_ = (position > pending) ? position - pending : 0;
+  }
+
+  buffer_.clear();
+  trackStarting_ = false;
+  chunkSize_ = 0;
+  endFillSize_ = 0;
+  storage_.close(MP3Storage::Clip);
+  if (not decoder_.cancel()) {
+    Console::instance_ << F("MP3 decoder did not cancel\n");
+  }
+
+  clip_ = &clips_[clip];
+  clipOffset_ = 0;
+
+  // the head from RAM, before any SD access
+  while (clipOffset_ < clip_->headSize_ && buffer_.free() >= ChunkSize) {
+    fillClipChunk();
+    buffer_.write(chunk_, chunkSize_);
+    chunkSize_ = 0;
+  }
+  drainFromLoop();
+  return true;
+}
+
+bool MP3Player::fillClipChunk()
+{
+  const size_t size = ChunkSize;
+  if (clipOffset_ < clip_->headSize_) {
+    const size_t remaining = clip_->headSize_ - clipOffset_;
+    chunkSize_ = (remaining < size) ? remaining : size;
+    memcpy(chunk_, clip_->head_ + clipOffset_, chunkSize_);
+    clipOffset_ += chunkSize_;
+    return true;
+  }
+
+  if (clipOffset_ >= clip_->size_) {
+    return false;
+  }
+
+  // rest of the clip, opened while the head is playing
+  const size_t slot = MP3Storage::Clip;
+  if (not storage_.isOpen(slot)
+      && (not open(clip_->track_, slot) || not storage_.seek(slot, clipOffset_))) {
+    storage_.close(slot);
+    return false;
+  }
+  const int read = storage_.read(slot, chunk_, size);
+  if (read <= 0) {
+    return false;
+  }
+  chunkSize_ = read;
+  clipOffset_ += read;
+  return true;
+}
+
+void MP3Player::drain()
+{
+  while (decoder_.ready()) {
+    size_t size = 0;
+    const uint8_t* data = buffer_.peek(size);
+    if (size == 0) {
+      if (decoderFilled_ && streaming_) {
+        ++underruns_;
+      }
+      decoderFilled_ = false;
+      return;
+    }
+
+    if (size > ChunkSize) {
+      size = ChunkSize;
     }
+    decoder_.write(data, size);
+    buffer_.consume(size);
+    if (triggerLatency_ == 0 && clip_ != nullptr) {
+      triggerLatency_ = Clock::micros() - triggerTime_;
+    }
+    // modulo size_t: signed of the same width, 16 bits on AVR
+    if (trackStarting_ && ptrdiff_t(buffer_.consumed() - trackStart_) > 0) {
+      trackStartTime_ = Clock::millis();
+      trackStarting_ = false;
+    }
+  }
+  decoderFilled_ = true;
+}
+
+void MP3Player::drainFromLoop()
+{
+  draining_ = true; // keep the interrupt away
+  drain();
+  // A DREQ edge while draining_ was set went unanswered, and no other one
+  // comes until more is written: check again once the interrupt is back.
+  for (;;) {
+    draining_ = false;
+    if (not decoder_.ready() || buffer_.available() == 0) {
+      return;
+    }
+    draining_ = true;
+    drain();
   }
+}
 
-  filename_ = nullptr;
+void MP3Player::onDataRequest()
+{
+  MP3Player* player = interruptInstance_;
+  if (player != nullptr && not player->draining_) {
+    player->drain();
+  }
 }
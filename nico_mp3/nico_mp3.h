@@ -25,30 +25,154 @@
 #ifndef NICO_MP3_H
 #define NICO_MP3_H
 
+#include "nico_config.h"
+#include "nico_mp3_backend.h"
 #include "nico_util.h"
 
-#include <SdFat.h>
-#include <vs1053_SdFat.h>
+//-----------------------------------------------------------------------------
+// Read-ahead between SD reads (main loop) and decoder writes (main loop or
+// DREQ interrupt): one producer, one consumer.
+class StreamBuffer {
+  public:
+    static const size_t Size = NICO_MP3_BUFFER_SIZE; // power of 2
+
+    void clear() { head_ = 0; tail_ = 0; } // neither side active
+    size_t available() const { return load(head_) - load(tail_); }
+    size_t free() const { return Size - available(); }
+    size_t written() const { return load(head_); } // total, modulo 2^n
+    size_t consumed() const { return load(tail_); }
+
+    void write(const uint8_t* data, size_t size); // producer, size <= free()
+    const uint8_t* peek(size_t& size) const; // consumer, contiguous bytes
+    void consume(size_t size);
+
+  private:
+    uint8_t data_[Size];
+    volatile size_t head_ = 0; // total bytes written, modulo 2^n
+    volatile size_t tail_ = 0; // total bytes read
+
+    static size_t load(const volatile size_t& index);
+};
 
 //-----------------------------------------------------------------------------
+// Tracks are streamed to the decoder through a read-ahead buffer filled by
+// update(). The next queued track is opened and its first bytes read while
+// the current one plays, so that tracks without delay follow each other
+// without gap.
+// RefillMode::Polled: update() also feeds the decoder, it must be called
+// often enough to keep it from running dry.
+// RefillMode::Interrupt: the decoder is fed from the DREQ interrupt, update()
+// only needs to be called often enough to keep the read-ahead buffer filled.
+// Falls back to polling with decoders without interrupt.
 class MP3Player : public Base {
   public:
-    MP3Player(SdFat& sd, DebugMode debugMode);
+    static const size_t QueueSize = 4;
+
+    enum class RefillMode { Polled, Interrupt };
+
+    MP3Player(MP3Storage& storage, MP3Decoder& decoder, DebugMode debugMode, RefillMode refillMode = RefillMode::Polled);
+    ~MP3Player();
 
-    void init();
-    void clear();
+    // false if the storage or the decoder did not start: nothing is then
+    // streamed, persistIndex keeps the track index in a file
+    bool init(bool persistIndex = false);
+    void clear(); // queued tracks
     void update();
 
-    bool readyForNext() const { return (filename_ == nullptr); }
-    void setNext(const char* filename, unsigned int duration);
+    bool readyForNext() const { return queue_.empty(); }
+    void setNext(const char* filename, unsigned int duration); // ms from now, not before the current track ends
+    bool enqueue(const char* filename, unsigned int delay = 0); // ms after the previous track, false if full
+    void setNextTrack(uint16_t id, unsigned int duration); // see TrackIndex
+    bool enqueueTrack(uint16_t id, unsigned int delay = 0);
+    void setLoop(bool loop) { loop_ = loop; } // requeue tracks once played
+    bool isPlaying() const;
+    // ms, Clock time when the current track reached the decoder, to keep
+    // e.g. a FrameStreamPlayer in sync
+    unsigned long trackStartTime() const { return trackStartTime_; }
+
+    // read-ahead buffer ran dry after the decoder had been filled
+    unsigned long underruns() const { return underruns_; }
+    void resetUnderruns() { underruns_ = 0; }
+
+    // Sound effects: the first bytes (or all) of a clip are kept in RAM and
+    // sent by trigger() right away, cutting the current track which goes on
+    // after the clip if resume is set.
+    static const size_t MaxClips = NICO_MP3_MAX_CLIPS;
+    static const size_t ClipHeadSize = NICO_MP3_CLIP_HEAD_SIZE; // bytes
+    int preload(const char* filename, size_t headSize = ClipHeadSize); // clip number, -1 on error
+    int preloadTrack(uint16_t id, size_t headSize = ClipHeadSize);
+    bool trigger(size_t clip, bool resume = true);
+    unsigned long triggerLatency() const { return triggerLatency_; } // us, from trigger() to the first clip data accepted by the decoder
 
   private:
-    SdFat& sd_;
-    vs1053 player_;
+    static const size_t ChunkSize = MP3Decoder::ChunkSize;
+    static const size_t EndFillSize = 2052; // flushes the decoder at the end of the stream
+
+    struct Track {
+      const char* filename_ = nullptr; // or by ID
+      uint16_t id_ = 0;
+      unsigned int delay_ = 0; // ms
+    };
+
+    struct Clip {
+      Track track_;
+      uint32_t size_ = 0; // bytes
+      uint8_t* head_ = nullptr;
+      size_t headSize_ = 0;
+    };
+
+    static MP3Player* interruptInstance_;
+
+    MP3Storage& storage_;
+    MP3Decoder& decoder_;
+    RefillMode refillMode_;
+    bool started_ = false; // see init()
     Timer timer_;
-    const char* filename_ = nullptr;
+    bool timerStarted_ = false;
+    Array<Track, QueueSize> queue_;
+    bool loop_ = false;
+
+    Track track_;
+    size_t file_ = MP3Storage::Current; // slots, swapped between tracks
+    uint8_t chunk_[ChunkSize];
+    size_t chunkSize_ = 0;
+    size_t endFillSize_ = 0;
+
+    size_t nextFile_ = MP3Storage::Next;
+    uint8_t nextChunk_[ChunkSize];
+    size_t nextChunkSize_ = 0;
+
+    Array<Clip, MaxClips> clips_;
+    const Clip* clip_ = nullptr; // playing
+    uint32_t clipOffset_ = 0;
+    bool resume_ = false;
+    uint32_t resumePosition_ = 0;
+    unsigned long triggerTime_ = 0; // us
+    unsigned long triggerLatency_ = 0; // us
+
+    StreamBuffer buffer_;
+    volatile bool streaming_ = false; // a track is being read
+    volatile bool draining_ = false;
+    volatile bool decoderFilled_ = false;
+    volatile unsigned long underruns_ = 0;
+    size_t trackStart_ = 0; // in the stream buffer, see StreamBuffer::written()
+    volatile bool trackStarting_ = false;
+    volatile unsigned long trackStartTime_ = 0;
 
-    bool isPlaying();
+    bool open(const Track& track, size_t slot);
+    bool enqueue(const Track& track);
+    void setNext(const Track& track, unsigned int duration);
+    void print(const Track& track) const;
+    bool due();
+    void prefetch();
+    bool startNext();
+    int preload(const Track& track, size_t headSize);
+    bool fillClipChunk();
+    bool fillChunk();
+    void readAhead();
+    void drain();
+    void drainFromLoop(); // not from the interrupt
+    static void onDataRequest();
 };
 
 #endif
@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nico_mp3_backend.h"
+
+//-----------------------------------------------------------------------------
+SimulatedStorage::SimulatedStorage(unsigned long openLatency, unsigned long blockLatency)
+: openLatency_(openLatency),
+  blockLatency_(blockLatency)
+{
+}
+
+bool SimulatedStorage::addTrack(uint16_t id, uint32_t size, const char* filename)
+{
+  if (files_.full()) {
+    return false;
+  }
+
+  File file;
+  file.filename_ = filename;
+  file.id_ = id;
+  file.size_ = size;
+  files_.push_back(file);
+  return true;
+}
+
+uint8_t SimulatedStorage::content(uint32_t position)
+{
+  return uint8_t(position) | 0x80;
+}
+
+bool SimulatedStorage::open(size_t slot, const char* filename)
+{
+  for (size_t i = 0; i < files_.size(); ++i) {
+    if (files_[i].filename_ != nullptr && strcasecmp(files_[i].filename_, filename) == 0) {
+      return open(slot, &files_[i]);
+    }
+  }
+  return open(slot, (const File*)nullptr);
+}
+
+bool SimulatedStorage::open(size_t slot, uint16_t id)
+{
+  return open(slot, find(id));
+}
+
+bool SimulatedStorage::open(size_t slot, const File* file)
+{
+  wait(openLatency_);
+  OpenFile& open = slots_[slot];
+  open.file_ = file;
+  open.position_ = 0;
+  open.block_ = 0;
+  return (file != nullptr);
+}
+
+const SimulatedStorage::File* SimulatedStorage::find(uint16_t id) const
+{
+  for (size_t i = 0; i < files_.size(); ++i) {
+    if (files_[i].id_ == id) {
+      return &files_[i];
+    }
+  }
+  return nullptr;
+}
+
+int SimulatedStorage::read(size_t slot, uint8_t* data, size_t size)
+{
+  OpenFile& open = slots_[slot];
+  if (open.file_ == nullptr) {
+    return -1;
+  }
+
+  const uint32_t remaining = open.file_->size_ - open.position_;
+  if (size > remaining) {
+    size = remaining;
+  }
+  if (size == 0) {
+    return 0;
+  }
+
+  // each block not read last costs a card access
+  const uint32_t first = open.position_ / BlockSize;
+  const uint32_t last = (open.position_ + size - 1) / BlockSize;
+  for (uint32_t block = first; block <= last; ++block) {
+    if (block + 1 != open.block_) {
+      wait(blockLatency_);
+    }
+  }
+  open.block_ = last + 1;
+
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = content(open.position_ + i);
+  }
+  open.position_ += size;
+  return size;
+}
+
+bool SimulatedStorage::seek(size_t slot, uint32_t position)
+{
+  OpenFile& open = slots_[slot];
+  if (open.file_ == nullptr || position > open.file_->size_) {
+    return false;
+  }
+  open.position_ = position;
+  return true;
+}
+
+uint32_t SimulatedStorage::size(size_t slot) const
+{
+  const OpenFile& open = slots_[slot];
+  return (open.file_ != nullptr) ? open.file_->size_ : 0;
+}
+
+void SimulatedStorage::wait(unsigned long duration)
+{
+  busyTime_ += duration;
+  if (Clock::simulated()) {
+    Clock::advanceMicros(duration);
+  } else {
+    delay(duration / 1000);
+    delayMicroseconds(duration % 1000);
+  }
+}
+
+//-----------------------------------------------------------------------------
+SimulatedDecoder::SimulatedDecoder(unsigned long bitrate)
+: byteRate_(bitrate / 8)
+{
+}
+
+bool SimulatedDecoder::begin()
+{
+  level_ = 0;
+  time_ = Clock::micros();
+  credit_ = 0;
+  starving_ = false;
+  streamEnded_ = true;
+  resetStats();
+  return true;
+}
+
+bool SimulatedDecoder::ready()
+{
+  return (FifoSize - level() >= ChunkSize);
+}
+
+void SimulatedDecoder::write(const uint8_t* data, size_t size)
+{
+  play();
+  if (starving_) {
+    ++gaps_;
+    gapTime_ += time_ - starveTime_;
+    starving_ = false;
+  }
+
+  bool zeros = true;
+  for (size_t i = 0; i < size && zeros; ++i) {
+    zeros = (data[i] == 0);
+  }
+  streamEnded_ = zeros;
+
+  // data beyond the FIFO is lost, as with a real decoder written without DREQ
+  level_ += size;
+  if (level_ > FifoSize) {
+    level_ = FifoSize;
+  }
+}
+
+bool SimulatedDecoder::cancel()
+{
+  play();
+  level_ = 0;
+  credit_ = 0;
+  starving_ = false;
+  streamEnded_ = true;
+  return true;
+}
+
+size_t SimulatedDecoder::level()
+{
+  play();
+  return level_;
+}
+
+void SimulatedDecoder::resetStats()
+{
+  bytesPlayed_ = 0;
+  gaps_ = 0;
+  gapTime_ = 0;
+}
+
+void SimulatedDecoder::play()
+{
+  const unsigned long time = Clock::micros();
+  const unsigned long elapsed = time - time_;
+  time_ = time;
+  if (level_ == 0) {
+    return;
+  }
+
+  credit_ += (unsigned long long)elapsed * byteRate_;
+  size_t size = credit_ / 1000000;
+  if (size < level_) {
+    credit_ -= (unsigned long long)size * 1000000;
+  } else {
+    // ran dry: when the last byte was played
+    const unsigned long dryTime = (credit_ - (unsigned long long)level_ * 1000000) / byteRate_;
+    size = level_;
+    credit_ = 0;
+    if (not streamEnded_) {
+      starving_ = true;
+      starveTime_ = time - dryTime;
+    }
+  }
+  level_ -= size;
+  bytesPlayed_ += size;
+}
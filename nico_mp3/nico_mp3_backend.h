@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef NICO_MP3_BACKEND_H
+#define NICO_MP3_BACKEND_H
+
+#include "nico_config.h"
+#include "nico_util.h"
+
+//-----------------------------------------------------------------------------
+// Where MP3Player reads tracks from. Files are opened in numbered slots.
+class MP3Storage {
+  public:
+    enum Slot { Current, Next, Clip, Preload, NumSlots };
+
+    virtual ~MP3Storage() {}
+
+    virtual bool begin(bool persistIndex) = 0; // keep the track index between runs, if supported
+    virtual size_t numTracks() const = 0;
+    virtual bool hasTrack(uint16_t id) const = 0;
+
+    virtual bool open(size_t slot, const char* filename) = 0;
+    virtual bool open(size_t slot, uint16_t id) = 0;
+    virtual bool isOpen(size_t slot) const = 0;
+    virtual void close(size_t slot) = 0;
+    virtual int read(size_t slot, uint8_t* data, size_t size) = 0; // bytes read, 0 at the end, -1 on error
+    virtual bool seek(size_t slot, uint32_t position) = 0;
+    virtual uint32_t position(size_t slot) const = 0;
+    virtual uint32_t size(size_t slot) const = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Where MP3Player sends the stream to: up to ChunkSize bytes can be written
+// whenever ready() is true.
+class MP3Decoder {
+  public:
+    static const size_t ChunkSize = 32; // bytes
+
+    virtual ~MP3Decoder() {}
+    virtual bool begin() = 0;
+    virtual bool ready() = 0;
+    virtual void write(const uint8_t* data, size_t size) = 0;
+    virtual bool cancel() = 0; // drop buffered data, false on timeout
+    virtual bool attachInterrupt(void (*handler)()) = 0; // called when ready() rises, false if not supported
+};
+
+//-----------------------------------------------------------------------------
+// Stand-ins for benchmarks and tests, also built on the host (see
+// tools/nico_mp3_simulation), best used with a simulated Clock: time then
+// only passes when the caller or the modeled latencies advance it.
+
+// Tracks of a given size and made up content. Reading a new block or opening
+// a file takes time, as on an SD card.
+class SimulatedStorage : public MP3Storage {
+  public:
+    static const size_t MaxFiles = NICO_MP3_MAX_TRACKS;
+    static const size_t BlockSize = 512; // bytes
+
+    SimulatedStorage(unsigned long openLatency = 5000, unsigned long blockLatency = 1000); // us
+
+    bool addTrack(uint16_t id, uint32_t size, const char* filename = nullptr); // false if full
+    unsigned long busyTime() const { return busyTime_; } // us spent in latencies
+    void resetBusyTime() { busyTime_ = 0; }
+
+    virtual bool begin(bool /*persistIndex*/) { return true; }
+    virtual size_t numTracks() const { return files_.size(); }
+    virtual bool hasTrack(uint16_t id) const { return find(id) != nullptr; }
+
+    virtual bool open(size_t slot, const char* filename);
+    virtual bool open(size_t slot, uint16_t id);
+    virtual bool isOpen(size_t slot) const { return slots_[slot].file_ != nullptr; }
+    virtual void close(size_t slot) { slots_[slot].file_ = nullptr; }
+    virtual int read(size_t slot, uint8_t* data, size_t size);
+    virtual bool seek(size_t slot, uint32_t position);
+    virtual uint32_t position(size_t slot) const { return slots_[slot].position_; }
+    virtual uint32_t size(size_t slot) const;
+
+    static uint8_t content(uint32_t position); // never 0, unlike the end fill
+
+  private:
+    struct File {
+      const char* filename_; // or nullptr
+      uint16_t id_;
+      uint32_t size_; // bytes
+    };
+
+    struct OpenFile {
+      const File* file_ = nullptr;
+      uint32_t position_ = 0;
+      uint32_t block_ = 0; // last read
+    };
+
+    const unsigned long openLatency_;
+    const unsigned long blockLatency_;
+    Array<File, MaxFiles> files_;
+    OpenFile slots_[NumSlots];
+    unsigned long busyTime_ = 0;
+
+    const File* find(uint16_t id) const;
+    bool open(size_t slot, const File* file);
+    void wait(unsigned long duration); // us
+};
+
+// Decoder FIFO played at a constant bitrate. Counts the gaps in the sound:
+// the FIFO running dry within a stream, i.e. before the zeros sent at its
+// end.
+class SimulatedDecoder : public MP3Decoder {
+  public:
+    static const size_t FifoSize = 2048; // bytes
+
+    explicit SimulatedDecoder(unsigned long bitrate = 128000); // bits/s
+
+    virtual bool begin();
+    virtual bool ready();
+    virtual void write(const uint8_t* data, size_t size);
+    virtual bool cancel();
+    virtual bool attachInterrupt(void (* /*handler*/)()) { return false; }
+
+    size_t level(); // bytes in the FIFO
+    unsigned long bytesPlayed() const { return bytesPlayed_; }
+    unsigned long gaps() const { return gaps_; }
+    unsigned long gapTime() const { return gapTime_; } // us
+    void resetStats();
+
+  private:
+    const unsigned long byteRate_; // bytes/s
+    size_t level_ = 0;
+    unsigned long time_ = 0; // us, last played
+    unsigned long long credit_ = 0; // bytes * 1e6 not played yet
+    unsigned long bytesPlayed_ = 0;
+    bool starving_ = false; // FIFO empty within a stream
+    unsigned long starveTime_ = 0; // us
+    bool streamEnded_ = true; // last chunk was zeros
+    unsigned long gaps_ = 0;
+    unsigned long gapTime_ = 0;
+
+    void play();
+};
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "nico_mp3_index.h"
+
+namespace {
+  const char Magic[4] = { 'N', 'T', 'I', 'X' };
+}
+
+//-----------------------------------------------------------------------------
+const TrackIndex::Entry* TrackIndex::find(uint16_t id) const
+{
+  size_t begin = 0;
+  size_t end = entries_.size();
+  while (begin < end) {
+    const size_t middle = (begin + end) / 2;
+    if (entries_[middle].id_ < id) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return (begin < entries_.size() && entries_[begin].id_ == id) ? &entries_[begin] : nullptr;
+}
+
+void TrackIndex::build(SdFat& sd)
+{
+  entries_.clear();
+
+  FatFile* dir = sd.vwd();
+  dir->rewind();
+  SdFile file;
+  char name[32];
+  while (file.openNext(dir, O_READ)) {
+    Entry entry;
+    if (file.isFile()
+        && file.getName(name, sizeof(name))
+        && parseId(name, entry.id_)) {
+      entry.dirIndex_ = file.dirIndex();
+      entry.size_ = file.fileSize();
+      if (not insert(entry)) {
+        Console::instance_ << F("Track '") << name << F("' not indexed\n");
+      }
+    }
+    file.close();
+  }
+}
+
+bool TrackIndex::load(SdFat& sd, const char* filename)
+{
+  SdFile file;
+  if (not file.open(sd.vwd(), filename, O_READ)) {
+    return false;
+  }
+
+  entries_.clear();
+  char magic[sizeof(Magic)];
+  uint16_t count = 0;
+  bool ok = (file.read(magic, sizeof(magic)) == sizeof(magic)
+    && memcmp(magic, Magic, sizeof(Magic)) == 0
+    && file.read(&count, sizeof(count)) == sizeof(count)
+    && count <= MaxCount);
+  for (size_t i = 0; ok && i < count; ++i) {
+    Entry entry;
+    ok = (file.read(&entry, sizeof(entry)) == sizeof(entry));
+    if (ok) {
+      entries_.push_back(entry);
+    }
+  }
+  file.close();
+
+  if (not ok) {
+    entries_.clear();
+  }
+  return ok;
+}
+
+bool TrackIndex::save(SdFat& sd, const char* filename) const
+{
+  SdFile file;
+  if (not file.open(sd.vwd(), filename, O_WRITE | O_CREAT | O_TRUNC)) {
+    return false;
+  }
+
+  const uint16_t count = entries_.size();
+  bool ok = (file.write((const uint8_t*)Magic, sizeof(Magic)) == sizeof(Magic)
+    && file.write((const uint8_t*)&count, sizeof(count)) == sizeof(count));
+  for (size_t i = 0; ok && i < count; ++i) {
+    ok = (file.write((const uint8_t*)&entries_[i], sizeof(Entry)) == sizeof(Entry));
+  }
+  file.close();
+  return ok;
+}
+
+bool TrackIndex::open(SdFat& sd, uint16_t id, SdFile& file) const
+{
+  const Entry* entry = find(id);
+  if (entry == nullptr
+      || not file.open(sd.vwd(), entry->dirIndex_, O_READ)) {
+    return false;
+  }
+  if (file.fileSize() != entry->size_) {
+    file.close(); // stale index
+    return false;
+  }
+  return true;
+}
+
+bool TrackIndex::insert(const Entry& entry)
+{
+  if (entries_.full() || find(entry.id_) != nullptr) {
+    return false;
+  }
+
+  size_t i = entries_.size();
+  entries_.push_back(entry);
+  for (; i > 0 && entries_[i - 1].id_ > entry.id_; --i) {
+    entries_[i] = entries_[i - 1];
+  }
+  entries_[i] = entry;
+  return true;
+}
+
+bool TrackIndex::parseId(const char* name, uint16_t& id)
+{
+  const char* ext = strrchr(name, '.');
+  if (ext == nullptr || strcasecmp(ext, ".mp3") != 0) {
+    return false;
+  }
+
+  const char* p = name;
+  while (p < ext && not isdigit(*p)) {
+    ++p;
+  }
+  if (p == ext) {
+    return false;
+  }
+
+  id = 0;
+  for (; p < ext && isdigit(*p); ++p) {
+    id = 10 * id + (*p - '0');
+  }
+  return true;
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NICO_MP3_INDEX_H
+#define NICO_MP3_INDEX_H
+
+#include "nico_config.h"
+#include "nico_util.h"
+
+#include <SdFat.h>
+
+//-----------------------------------------------------------------------------
+// MP3 files of the current directory by numeric ID: the first number in
+// the filename, e.g. 12 for "track012.mp3" or "012_rain.mp3".
+// Files are opened by directory index, without walking the directory.
+class TrackIndex {
+  public:
+    static const size_t MaxCount = NICO_MP3_MAX_TRACKS;
+
+    struct Entry {
+      uint16_t id_;
+      uint16_t dirIndex_;
+      uint32_t size_; // bytes, to detect a stale index
+    };
+
+    size_t size() const { return entries_.size(); }
+    const Entry* find(uint16_t id) const;
+
+    void build(SdFat& sd);
+    bool load(SdFat& sd, const char* filename);
+    bool save(SdFat& sd, const char* filename) const;
+    bool open(SdFat& sd, uint16_t id, SdFile& file) const;
+
+  private:
+    Array<Entry, MaxCount> entries_;
+
+    bool insert(const Entry& entry); // sorted by ID
+    static bool parseId(const char* name, uint16_t& id);
+};
+
+#endif
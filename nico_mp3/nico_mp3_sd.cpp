@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#include "nico_mp3_sd.h"
+
+#include <FreeStack.h>
+#include <SPI.h>
+
+//-----------------------------------------------------------------------------
+const char* SdStorage::IndexFilename = "TRACKS.IDX";
+
+bool SdStorage::begin(bool persistIndex)
+{
+  if (not sd_.begin(SD_SEL, SPI_FULL_SPEED)) {
+    sd_.initErrorHalt();
+    return false;
+  }
+  if (not sd_.chdir("/")) {
+    sd_.errorHalt("sd.chdir");
+    return false;
+  }
+
+  // index tracks by ID
+  persistIndex_ = persistIndex;
+  if (not persistIndex_ || not index_.load(sd_, IndexFilename)) {
+    buildIndex();
+  }
+  return true;
+}
+
+void SdStorage::buildIndex()
+{
+  index_.build(sd_);
+  if (persistIndex_ && not index_.save(sd_, IndexFilename)) {
+    Console::instance_ << F("Cannot write '") << IndexFilename << F("'\n");
+  }
+}
+
+bool SdStorage::open(size_t slot, const char* filename)
+{
+  return files_[slot].open(filename, O_READ);
+}
+
+bool SdStorage::open(size_t slot, uint16_t id)
+{
+  if (index_.open(sd_, id, files_[slot])) {
+    return true;
+  }
+
+  // files changed since the index was built
+  buildIndex();
+  return index_.open(sd_, id, files_[slot]);
+}
+
+//-----------------------------------------------------------------------------
+bool VS1053Decoder::begin()
+{
+  const uint8_t res = player_.begin();
+  if (res != 0) {
+    Console::instance_ << F("Error code: ") << res << F(" when trying to start MP3 player\n");
+    return false;
+  }
+  return true;
+}
+
+bool VS1053Decoder::ready()
+{
+  return (digitalRead(MP3_DREQ) == HIGH);
+}
+
+void VS1053Decoder::write(const uint8_t* data, size_t size)
+{
+  SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE0));
+  digitalWrite(MP3_XDCS, LOW);
+  for (size_t i = 0; i < size; ++i) {
+    SPI.transfer(data[i]);
+  }
+  digitalWrite(MP3_XDCS, HIGH);
+  SPI.endTransaction();
+}
+
+bool VS1053Decoder::cancel()
+{
+  // discard the decoder buffer: data is sent until SM_CANCEL clears
+  player_.Mp3WriteRegister(SCI_MODE, player_.Mp3ReadRegister(SCI_MODE) | SM_CANCEL);
+  uint8_t zeros[ChunkSize];
+  memset(zeros, 0, sizeof(zeros));
+  const unsigned long startTime = ::millis(); // hardware timeout: real time, also under a simulated Clock
+  for (size_t size = 0; size < CancelSize; ) {
+    if (::millis() - startTime > CancelTimeout) {
+      break;
+    }
+    if (not ready()) {
+      continue;
+    }
+    write(zeros, ChunkSize);
+    size += ChunkSize;
+    if ((player_.Mp3ReadRegister(SCI_MODE) & SM_CANCEL) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool VS1053Decoder::attachInterrupt(void (*handler)())
+{
+  // SD card transactions must not be interrupted by decoder writes
+  SPI.usingInterrupt(digitalPinToInterrupt(MP3_DREQ));
+  ::attachInterrupt(digitalPinToInterrupt(MP3_DREQ), handler, RISING);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+SdMP3Player::SdMP3Player(SdFat& sd, DebugMode debugMode, RefillMode refillMode)
+: SdMP3Backends(sd),
+  MP3Player(sdStorage_, sdDecoder_, debugMode, refillMode)
+{
+  Arena::account(F("MP3 SD backends"), sizeof(SdMP3Backends));
+}
+
+bool SdMP3Player::init(bool persistIndex)
+{
+  if (debugMode() != DebugMode::None) {
+    Console::instance_ << "\n" << F("F_CPU = ") << F_CPU << "\n";
+    Console::instance_ << F("Free RAM = ") << FreeStack() << F(" Should be a base line of 1028, on ATmega328 when using INTx\n");
+  }
+  return MP3Player::init(persistIndex);
+}
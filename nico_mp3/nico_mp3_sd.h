@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+#ifndef NICO_MP3_SD_H
+#define NICO_MP3_SD_H
+
+#include "nico_mp3.h"
+#include "nico_mp3_index.h"
+
+#include <SdFat.h>
+#include <vs1053_SdFat.h>
+
+//-----------------------------------------------------------------------------
+// Files of the SD card, tracks by ID through a TrackIndex.
+class SdStorage : public MP3Storage {
+  public:
+    static const char* IndexFilename;
+
+    explicit SdStorage(SdFat& sd) : sd_(sd) {}
+
+    const TrackIndex& index() const { return index_; }
+
+    virtual bool begin(bool persistIndex);
+    virtual size_t numTracks() const { return index_.size(); }
+    virtual bool hasTrack(uint16_t id) const { return index_.find(id) != nullptr; }
+
+    virtual bool open(size_t slot, const char* filename);
+    virtual bool open(size_t slot, uint16_t id);
+    virtual bool isOpen(size_t slot) const { return files_[slot].isOpen(); }
+    virtual void close(size_t slot) { files_[slot].close(); }
+    virtual int read(size_t slot, uint8_t* data, size_t size) { return files_[slot].read(data, size); }
+    virtual bool seek(size_t slot, uint32_t position) { return files_[slot].seekSet(position); }
+    virtual uint32_t position(size_t slot) const { return files_[slot].curPosition(); }
+    virtual uint32_t size(size_t slot) const { return files_[slot].fileSize(); }
+
+  private:
+    SdFat& sd_;
+    TrackIndex index_;
+    bool persistIndex_ = false;
+    SdFile files_[NumSlots];
+
+    void buildIndex();
+};
+
+//-----------------------------------------------------------------------------
+// The vs1053 of the MP3 shield, data written over SPI while DREQ is high.
+class VS1053Decoder : public MP3Decoder {
+  public:
+    static const unsigned long CancelTimeout = 50; // ms
+
+    virtual bool begin();
+    virtual bool ready();
+    virtual void write(const uint8_t* data, size_t size);
+    virtual bool cancel();
+    virtual bool attachInterrupt(void (*handler)());
+
+  private:
+    static const size_t CancelSize = 2048; // bytes, data sent at most until SM_CANCEL clears
+
+    vs1053 player_;
+};
+
+//-----------------------------------------------------------------------------
+// MP3Player of the MP3 shield: SD card and vs1053. The backends are
+// constructed before the player that uses them.
+struct SdMP3Backends {
+  explicit SdMP3Backends(SdFat& sd) : sdStorage_(sd) {}
+
+  SdStorage sdStorage_;
+  VS1053Decoder sdDecoder_;
+};
+
+class SdMP3Player : private SdMP3Backends, public MP3Player {
+  public:
+    SdMP3Player(SdFat& sd, DebugMode debugMode, RefillMode refillMode = RefillMode::Polled);
+
+    bool init(bool persistIndex = false); // see MP3Player::init()
+};
+
+#endif
@@ -41,6 +41,7 @@ ServoDriver::ServoDriver(ServoType type, DebugMode debugMode, uint8_t address, T
   data_(SERVO_DATA[(size_t)type]),
   driver_(address, i2c)
 {
+  Arena::account(F("ServoDriver"), sizeof(ServoDriver));
 }
 
 void ServoDriver::setup(size_t index, double beginAngle, double endAngle)
@@ -74,6 +75,11 @@ bool ServoDriver::inRange(size_t index, double angle) const
 }
 
 void ServoDriver::set(size_t index, double angle)
+{
+  set(index, angle, arbitrated());
+}
+
+void ServoDriver::set(size_t index, double angle, bool deferred)
 {
   if (not inRange(index, angle)) {
     if (debugMode() != DebugMode::None) {
@@ -83,8 +89,14 @@ void ServoDriver::set(size_t index, double angle)
   }
 
   const uint16_t usec = data_.usMin_ + angle * (data_.usMax_ - data_.usMin_) / data_.maxAngle_;
-  if (debugMode() != DebugMode::DryRun) {
-    driver_.writeMicroseconds(index, usec);
+  if (deferred) {
+    dataVector_[index].usec_ = usec;
+    pending_ |= uint16_t(1) << index;
+  } else {
+    pending_ &= ~(uint16_t(1) << index); // superseded
+    if (debugMode() != DebugMode::DryRun) {
+      driver_.writeMicroseconds(index, usec);
+    }
   }
   dataVector_[index].angle_ = angle;
 
@@ -93,6 +105,16 @@ void ServoDriver::set(size_t index, double angle)
   }
 }
 
+void ServoDriver::transfer()
+{
+  for (size_t i = 0; i < MAX_COUNT; ++i) {
+    if ((pending_ & (uint16_t(1) << i)) && debugMode() != DebugMode::DryRun) {
+      driver_.writeMicroseconds(i, dataVector_[i].usec_);
+    }
+  }
+  pending_ = 0;
+}
+
 void ServoDriver::move(size_t index, double toAngle, double speed)
 {
   if (not inRange(index, toAngle)
@@ -104,17 +126,17 @@ void ServoDriver::move(size_t index, double toAngle, double speed)
   double angle = dataVector_[index].angle_ + inc;
   if (angle < toAngle) {
     for (; angle < toAngle; angle += inc) {
-      set(index, angle);
+      set(index, angle, false);
     }
   } else {
     for (; angle > toAngle; angle -= inc) {
-      set(index, angle);
+      set(index, angle, false);
     }
   }
 
   // make sure requested angle is set
   if (angle != toAngle) {
-    set(index, toAngle);
+    set(index, toAngle, false);
   }
 }
 
@@ -147,6 +169,7 @@ ServoManager::ServoManager(ServoType type, DebugMode debugMode, uint8_t address,
 : Base(debugMode),
   driver_(type, debugMode, address, i2c)
 {
+  Arena::account(F("ServoManager"), sizeof(dataVector_)); // the driver accounts for itself
 }
 
 void ServoManager::setup(size_t index, double beginAngle, double endAngle)
@@ -164,7 +187,7 @@ void ServoManager::set(size_t index, unsigned int duration, unsigned int offset)
   dataVector_[index].action_ = NoAction;
   dataVector_[index].duration_ = duration;
   if (duration != 0) {
-    dataVector_[index].offset_ = millis() + offset % (2 * duration);
+    dataVector_[index].offset_ = Clock::millis() + offset % (2 * duration);
   }
 }
 
@@ -182,7 +205,7 @@ void ServoManager::clear()
 
 void ServoManager::update()
 {
-  const unsigned long time = millis();
+  const unsigned long time = Clock::millis();
 
   for (size_t i = 0; i < ServoDriver::MAX_COUNT; ++i) {
     if (not driver_.enabled(i)) {
@@ -25,6 +25,8 @@
 #ifndef NICO_SERVO_H
 #define NICO_SERVO_H
 
+#include "nico_config.h"
+#include "nico_i2c.h"
 #include "nico_util.h"
 
 #include <Adafruit_PWMServoDriver.h>
@@ -38,9 +40,12 @@ struct ServoData {
 };
 
 //-----------------------------------------------------------------------------
-class ServoDriver : public Base {
+// Given to an I2CArbiter, set() only records the pulse widths, written by
+// the arbiter. move() blocks anyway: it still writes each of its steps, so
+// that the speed keeps its meaning.
+class ServoDriver : public Base, public I2CClient {
   public:
-    static const size_t MAX_COUNT = 8;
+    static const size_t MAX_COUNT = NICO_SERVO_MAX_COUNT;
 
     explicit ServoDriver(ServoType type, DebugMode debugMode, uint8_t address = 0x40, TwoWire& ic2 = Wire);
 
@@ -60,17 +65,24 @@ class ServoDriver : public Base {
     void moveAllToBegin();
     void moveAllToEnd();
 
+    virtual bool pending() { return pending_ != 0; }
+    virtual void transfer();
+
   private:
     struct Data {
         bool enabled_ = false;
         double beginAngle_;
         double endAngle_;
         double angle_ = 0.0;
+        uint16_t usec_ = 0; // to write
     };
 
     const ServoData& data_;
     Adafruit_PWMServoDriver driver_;
     Data dataVector_[MAX_COUNT];
+    uint16_t pending_ = 0; // mask
+
+    void set(size_t index, double angle, bool deferred);
 };
 
 //-----------------------------------------------------------------------------
@@ -94,6 +106,8 @@ class ServoManager : public Base {
     void update();
     void clear();
 
+    ServoDriver& driver() { return driver_; } // to give to an I2CArbiter
+
   private:
     ServoDriver driver_;
     Data dataVector_[ServoDriver::MAX_COUNT];
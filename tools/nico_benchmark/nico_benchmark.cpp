@@ -0,0 +1,241 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Benchmark of the rendering, servo and filter hot paths, on the host.
+//
+// The library is built against the stand-ins of ../../host: NeoPixel arrays
+// run in DebugMode::DryRun, the servo driver writes to an I2C bus without
+// devices that takes no time, and the Sharp sensor always reads the same
+// distance. Only the library code is measured.
+// Results are printed as CSV lines, one per benchmark:
+//   bench,name,param1,param2,iterations,total_us,ns_per_op,ops_per_sec
+//
+// Build on Linux, from this directory:
+//   g++ -O2 -I../../host -I../../nico -I../../nico_servo -o nico_benchmark nico_benchmark.cpp
+//     ../../host/Arduino.cpp ../../nico/nico_i2c.cpp ../../nico/nico_memory.cpp ../../nico/nico_neo_pixel.cpp
+//     ../../nico/nico_neo_pixel_blend.cpp ../../nico/nico_neo_pixel_map.cpp ../../nico/nico_neo_pixel_transport.cpp
+//     ../../nico/nico_neo_pixel_util.cpp ../../nico/nico_proximity.cpp ../../nico/nico_triple_buffer.cpp
+//     ../../nico/nico_util.cpp ../../nico_servo/nico_servo.cpp
+
+#include "nico_neo_pixel.h"
+#include "nico_proximity.h"
+#include "nico_servo.h"
+
+#include <stdio.h>
+
+#define BENCH_PIXEL_PIN 6
+#define BENCH_SHARP_PIN A0
+#define BENCH_DURATION 1000 // ms per benchmark
+
+//-----------------------------------------------------------------------------
+volatile uint32_t sink = 0; // keep the optimizer from dropping the work
+
+static void report(const char* name, unsigned long param1, unsigned long param2,
+                   unsigned long iterations, unsigned long totalUs, unsigned long opsPerIteration)
+{
+  const double ops = double(iterations) * opsPerIteration;
+  printf("bench,%s,%lu,%lu,%lu,%lu,%.2f,%.2f\n", name, param1, param2, iterations, totalUs,
+    1000.0 * totalUs / ops, 1e6 * ops / totalUs);
+}
+
+//-----------------------------------------------------------------------------
+static void benchNeoPixelArray(size_t numPixels, size_t numSnakes)
+{
+  NeoPixelArray array(numPixels, BENCH_PIXEL_PIN, NEO_GRB, DebugMode::DryRun);
+  array.init();
+  NeoPixelBaseArray base(array, 0, numPixels, DebugMode::DryRun);
+  for (size_t k = 0; k < numSnakes; ++k) {
+    const SnakeSetup setup { Color(50, 0, 50), k * numPixels / 4, (k % 2) ? CW : CCW, numPixels / 4, 1.0, 100 };
+    base.add(setup);
+  }
+  base.add(PulseSetup { Color(0, 10, 0), 500 });
+
+  unsigned long iterations = 0;
+  const unsigned long start = micros();
+  unsigned long elapsed = 0;
+  while (elapsed < 1000UL * BENCH_DURATION) {
+    base.render();
+    ++iterations;
+    elapsed = micros() - start;
+  }
+  report("neo_pixel_render", numPixels, numSnakes + 1, iterations, elapsed, numPixels);
+}
+
+static void benchNeoPixelRandom(size_t numPixels)
+{
+  NeoPixelArray array(numPixels, BENCH_PIXEL_PIN, NEO_GRB, DebugMode::DryRun);
+  array.init();
+  NeoPixelBaseArray base(array, 0, numPixels, DebugMode::DryRun);
+  base.add(RandomSetup { Color(50, 50, 50), Color(0, 0, 5), 8, 1 });
+  base.setFramePeriod(0);
+
+  unsigned long iterations = 0;
+  const unsigned long start = micros();
+  unsigned long elapsed = 0;
+  while (elapsed < 1000UL * BENCH_DURATION) {
+    base.update();
+    base.render();
+    ++iterations;
+    elapsed = micros() - start;
+  }
+  report("neo_pixel_random", numPixels, 1, iterations, elapsed, numPixels);
+}
+
+static void benchNeoPixelPalette(size_t numPixels)
+{
+  NeoPixelArray array(numPixels, BENCH_PIXEL_PIN, NEO_GRB, DebugMode::DryRun);
+  array.init();
+  NeoPixelPaletteArray palette(array, 0, numPixels, 16, DebugMode::DryRun);
+  if (not palette.init()) {
+    return;
+  }
+  for (size_t i = 0; i < palette.paletteSize(); ++i) {
+    palette.setPalette(i, Color(16 * i, 255 - 16 * i, 0));
+  }
+  for (size_t i = 0; i < numPixels; ++i) {
+    palette.set(i, i);
+  }
+
+  unsigned long iterations = 0;
+  const unsigned long start = micros();
+  unsigned long elapsed = 0;
+  while (elapsed < 1000UL * BENCH_DURATION) {
+    palette.render();
+    ++iterations;
+    elapsed = micros() - start;
+  }
+  report("neo_pixel_palette", numPixels, palette.paletteSize(), iterations, elapsed, numPixels);
+}
+
+static void benchNeoPixelSpatial(size_t width, size_t height)
+{
+  const size_t numPixels = width * height;
+  PixelMap map(DebugMode::None);
+  if (not map.initMatrix(width, height, true)) {
+    return;
+  }
+  NeoPixelArray array(numPixels, BENCH_PIXEL_PIN, NEO_GRB, DebugMode::DryRun);
+  array.init();
+  NeoPixelBaseArray base(array, 0, numPixels, DebugMode::DryRun);
+  base.setMap(&map);
+  base.add(GradientSetup { Color(50, 0, 0), Color(0, 0, 50), 45, 1000 });
+  base.add(WaveSetup { Color(0, 50, 0), 0.5, 0.5, 0.0, 0.25, 500 });
+
+  unsigned long iterations = 0;
+  const unsigned long start = micros();
+  unsigned long elapsed = 0;
+  while (elapsed < 1000UL * BENCH_DURATION) {
+    base.render();
+    ++iterations;
+    elapsed = micros() - start;
+  }
+  report("neo_pixel_spatial", width, height, iterations, elapsed, numPixels);
+}
+
+static void benchColorAdd()
+{
+  const Color src(200, 100, 50, 25);
+  const size_t batch = 256;
+
+  unsigned long iterations = 0;
+  const unsigned long start = micros();
+  unsigned long elapsed = 0;
+  while (elapsed < 1000UL * BENCH_DURATION) {
+    Color color;
+    for (size_t i = 0; i < batch; ++i) {
+      color.add(src, double(i) / batch);
+    }
+    sink += color.r_ + color.g_ + color.b_ + color.w_;
+    ++iterations;
+    elapsed = micros() - start;
+  }
+  report("color_add", batch, 0, iterations, elapsed, batch);
+}
+
+// the driver writes reach Wire, which has no devices on the host
+static void benchServoManager(size_t numChannels)
+{
+  ServoManager manager(ServoType::SG92R, DebugMode::None);
+  for (size_t i = 0; i < numChannels; ++i) {
+    manager.setup(i, 0, 180);
+    manager.set(i, 1000 + 100 * i, 0);
+  }
+  manager.init();
+
+  unsigned long iterations = 0;
+  const unsigned long start = micros();
+  unsigned long elapsed = 0;
+  while (elapsed < 1000UL * BENCH_DURATION) {
+    manager.update();
+    ++iterations;
+    elapsed = micros() - start;
+  }
+  report("servo_update", numChannels, 0, iterations, elapsed, (numChannels == 0) ? 1 : numChannels);
+}
+
+static void benchSharpFilter()
+{
+  // measurements are only taken once every 100ms, in between getDistance()
+  // only runs the glitch filter
+  SharpProximityDetector detector(SharpIR::GP2Y0A21YK0F, BENCH_SHARP_PIN, 10, 80);
+  detector.init();
+
+  unsigned long iterations = 0;
+  const unsigned long start = micros();
+  unsigned long elapsed = 0;
+  while (elapsed < 1000UL * BENCH_DURATION) {
+    sink += detector.getDistance();
+    ++iterations;
+    elapsed = micros() - start;
+  }
+  report("sharp_filter", 5, 0, iterations, elapsed, 1);
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  printf("# name,param1,param2,iterations,total_us,ns_per_op,ops_per_sec\n");
+
+  const size_t sizes[] = { 16, 60, 150, 300 };
+  const size_t snakes[] = { 0, 1, 4 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    for (size_t k = 0; k < sizeof(snakes) / sizeof(snakes[0]); ++k) {
+      benchNeoPixelArray(sizes[s], snakes[k]);
+    }
+    benchNeoPixelRandom(sizes[s]);
+    benchNeoPixelPalette(sizes[s]);
+  }
+  benchNeoPixelSpatial(16, 16);
+
+  benchColorAdd();
+
+  for (size_t n = 1; n <= ServoDriver::MAX_COUNT; n *= 2) {
+    benchServoManager(n);
+  }
+
+  benchSharpFilter();
+
+  printf("# done\n");
+  return 0;
+}
@@ -0,0 +1,455 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+// Compiles NeoPixel frames into the frame stream played from the SD card by
+// FrameStreamPlayer (see nico_frame_stream_format.h), and reports its size
+// and the bandwidth it needs.
+//
+// Input, in the wire layout of the strip:
+//   - an effect script, with --script: effects rendered by the library under
+//     a simulated clock, as on the unit. One directive per line, # for
+//     comments, pixels first and effects layered in their order:
+//       pixels 60 grb                   size and type: rgb, grb, rgbw, grbw
+//       seed 1234                       of the effects random generator
+//       duration 10000                  ms
+//       snake 255 0 128 0 cw 10 1.0 30  SnakeSetup: r g b, offset, cw or ccw,
+//                                       length, fade factor, ms per pixel
+//       pulse 40 40 0 170               PulseSetup: r g b, ms
+//       random 200 200 200 0 0 10 8 40  RandomSetup: r g b, background r g b,
+//                                       count, ms
+//   - a FrameRecorder capture (nico_frame.h): effects rendered by a sketch,
+//     on a unit or under a simulated clock as nico_golden_frames does. The
+//     capture is resampled to the frame period.
+//   - raw frames back to back, with --pixels and --bpp.
+//
+// Build on Linux, from this directory (../../host stands in for the Arduino
+// core and the libraries the effects use):
+//   g++ -O2 -I../../host -I../../nico -I../../nico_mp3 -o nico_frame_compiler nico_frame_compiler.cpp
+//     ../../host/Arduino.cpp ../../nico_mp3/nico_frame_stream_format.cpp ../../nico/nico_memory.cpp
+//     ../../nico/nico_neo_pixel.cpp ../../nico/nico_neo_pixel_blend.cpp ../../nico/nico_neo_pixel_map.cpp
+//     ../../nico/nico_neo_pixel_transport.cpp ../../nico/nico_neo_pixel_util.cpp
+//     ../../nico/nico_triple_buffer.cpp ../../nico/nico_util.cpp
+// Usage:
+//   nico_frame_compiler [options] input output
+//   --script         input is an effect script
+//   --period us      frame period, default 20000 (50 fps)
+//   --key frames     key frame interval, default 1 s
+//   --audio id       MP3 track played along, see TrackIndex
+//   --pixels n       raw input: number of pixels
+//   --bpp n          raw input: bytes per pixel, 3 or 4
+//   --budget kB/s    fail if a second of animation reads more from the SD
+
+#include "nico_frame_stream_format.h"
+#include "nico_neo_pixel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+  struct Options {
+    unsigned long period_ = 20000; // us
+    unsigned long keyInterval_ = 0; // frames, 0 for 1 s
+    unsigned long audioTrack_ = 0;
+    unsigned long numPixels_ = 0; // raw input
+    unsigned long bytesPerPixel_ = 0;
+    double budget_ = 0.0; // kB/s
+    bool script_ = false;
+    const char* input_ = nullptr;
+    const char* output_ = nullptr;
+  };
+
+  struct Frames {
+    size_t numPixels_ = 0;
+    size_t bytesPerPixel_ = 0;
+    std::vector<std::vector<uint8_t> > frames_;
+
+    size_t frameSize() const { return numPixels_ * bytesPerPixel_; }
+  };
+
+  void usage()
+  {
+    fprintf(stderr,
+      "usage: nico_frame_compiler [--script] [--period us] [--key frames] [--audio id]\n"
+      "                           [--pixels n --bpp n] [--budget kB/s] input output\n");
+    exit(2);
+  }
+
+  bool parse(int argc, char** argv, Options& options)
+  {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg.compare(0, 2, "--") != 0) {
+        if (options.input_ == nullptr) {
+          options.input_ = argv[i];
+        } else if (options.output_ == nullptr) {
+          options.output_ = argv[i];
+        } else {
+          return false;
+        }
+        continue;
+      }
+      if (arg == "--script") {
+        options.script_ = true;
+        continue;
+      }
+      if (i + 1 == argc) {
+        return false;
+      }
+      const char* value = argv[++i];
+      if (arg == "--period") {
+        options.period_ = strtoul(value, nullptr, 10);
+      } else if (arg == "--key") {
+        options.keyInterval_ = strtoul(value, nullptr, 10);
+      } else if (arg == "--audio") {
+        options.audioTrack_ = strtoul(value, nullptr, 10);
+      } else if (arg == "--pixels") {
+        options.numPixels_ = strtoul(value, nullptr, 10);
+      } else if (arg == "--bpp") {
+        options.bytesPerPixel_ = strtoul(value, nullptr, 10);
+        if (options.bytesPerPixel_ != 3 && options.bytesPerPixel_ != 4) {
+          return false;
+        }
+      } else if (arg == "--budget") {
+        options.budget_ = strtod(value, nullptr);
+      } else {
+        return false;
+      }
+    }
+    return (options.input_ != nullptr && options.output_ != nullptr && options.period_ != 0);
+  }
+
+  bool readFile(const char* filename, std::vector<uint8_t>& data)
+  {
+    FILE* file = fopen(filename, "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    uint8_t buffer[4096];
+    size_t size = 0;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) != 0) {
+      data.insert(data.end(), buffer, buffer + size);
+    }
+    fclose(file);
+    return true;
+  }
+
+  // FrameRecorder capture, resampled: the latest frame at each period
+  bool readCapture(const std::vector<uint8_t>& data, unsigned long period, Frames& frames)
+  {
+    const size_t headerSize = 8;
+    if (data.size() < headerSize || memcmp(data.data(), "NFRM", 4) != 0 || data[4] != 1) {
+      return false;
+    }
+    frames.bytesPerPixel_ = data[5];
+    frames.numPixels_ = FrameStream::read16(&data[6]);
+    if (frames.bytesPerPixel_ != 3 && frames.bytesPerPixel_ != 4) {
+      return false;
+    }
+    const size_t recordSize = 4 + frames.frameSize();
+    const size_t numRecords = (data.size() - headerSize) / recordSize;
+    if (numRecords == 0) {
+      return false;
+    }
+
+    const uint8_t* records = &data[headerSize];
+    const uint32_t start = FrameStream::read32(records);
+    const uint32_t end = FrameStream::read32(records + (numRecords - 1) * recordSize);
+    const size_t numFrames = size_t((end - start) * 1000.0 / period) + 1;
+    size_t record = 0;
+    for (size_t frame = 0; frame < numFrames; ++frame) {
+      const double time = start + frame * period / 1000.0; // ms
+      while (record + 1 < numRecords && FrameStream::read32(records + (record + 1) * recordSize) <= time) {
+        ++record;
+      }
+      const uint8_t* pixels = records + record * recordSize + 4;
+      frames.frames_.push_back(std::vector<uint8_t>(pixels, pixels + frames.frameSize()));
+    }
+    return true;
+  }
+
+  struct Effect {
+    char type_; // 's'nake, 'p'ulse or 'r'andom
+    SnakeSetup snake_;
+    PulseSetup pulse_;
+    RandomSetup random_;
+  };
+
+  bool parseType(const char* name, unsigned int& type)
+  {
+    static const struct { const char* name_; unsigned int type_; } types[] = {
+      { "rgb", NEO_RGB }, { "grb", NEO_GRB }, { "rgbw", NEO_RGBW }, { "grbw", NEO_GRBW },
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+      if (strcmp(name, types[i].name_) == 0) {
+        type = types[i].type_;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool parseEffect(const char* keyword, const char* args, Effect& effect)
+  {
+    unsigned int r, g, b, br, bg, bb, duration;
+    unsigned long offset, length, count;
+    double fade;
+    char dir[4];
+    int end = 0;
+    if (strcmp(keyword, "snake") == 0) {
+      if (sscanf(args, "%u %u %u %lu %3s %lu %lf %u %n", &r, &g, &b, &offset, dir, &length, &fade, &duration, &end) != 8
+          || (strcmp(dir, "cw") != 0 && strcmp(dir, "ccw") != 0)) {
+        return false;
+      }
+      effect.type_ = 's';
+      effect.snake_ = SnakeSetup { Color(r, g, b), offset, (dir[1] == 'w') ? CW : CCW, length, fade, duration };
+    } else if (strcmp(keyword, "pulse") == 0) {
+      if (sscanf(args, "%u %u %u %u %n", &r, &g, &b, &duration, &end) != 4) {
+        return false;
+      }
+      effect.type_ = 'p';
+      effect.pulse_ = PulseSetup { Color(r, g, b), duration };
+    } else if (strcmp(keyword, "random") == 0) {
+      if (sscanf(args, "%u %u %u %u %u %u %lu %u %n", &r, &g, &b, &br, &bg, &bb, &count, &duration, &end) != 8) {
+        return false;
+      }
+      effect.type_ = 'r';
+      effect.random_ = RandomSetup { Color(r, g, b), Color(br, bg, bb), count, duration };
+    } else {
+      return false;
+    }
+    const bool background = (effect.type_ != 'r' || (br <= 255 && bg <= 255 && bb <= 255));
+    return (args[end] == '\0' && r <= 255 && g <= 255 && b <= 255 && background);
+  }
+
+  // effect script, rendered by NeoPixelArray at each period
+  bool readScript(const std::vector<uint8_t>& data, const char* filename, unsigned long period, Frames& frames)
+  {
+    unsigned long numPixels = 0;
+    unsigned int type = NEO_GRB;
+    unsigned long seed = 1;
+    unsigned long duration = 0; // ms
+    std::vector<Effect> effects;
+
+    const std::string text(data.begin(), data.end());
+    size_t lineNumber = 0;
+    for (size_t begin = 0; begin < text.size(); ) {
+      size_t end = text.find('\n', begin);
+      end = (end == std::string::npos) ? text.size() : end;
+      std::string line = text.substr(begin, end - begin);
+      begin = end + 1;
+      ++lineNumber;
+      line = line.substr(0, line.find('#'));
+
+      char keyword[16];
+      int argsOffset = 0;
+      if (sscanf(line.c_str(), " %15s %n", keyword, &argsOffset) != 1) {
+        continue; // blank
+      }
+      const char* args = line.c_str() + argsOffset;
+      char name[8];
+      int rest = 0;
+      bool valid = false;
+      if (strcmp(keyword, "pixels") == 0) {
+        valid = (effects.empty() && sscanf(args, "%lu %7s %n", &numPixels, name, &rest) == 2
+          && args[rest] == '\0' && parseType(name, type) && numPixels > 0 && numPixels <= 0xFFFF);
+      } else if (strcmp(keyword, "seed") == 0) {
+        valid = (sscanf(args, "%lu %n", &seed, &rest) == 1 && args[rest] == '\0');
+      } else if (strcmp(keyword, "duration") == 0) {
+        valid = (sscanf(args, "%lu %n", &duration, &rest) == 1 && args[rest] == '\0');
+      } else {
+        Effect effect;
+        valid = (numPixels != 0 && parseEffect(keyword, args, effect));
+        if (valid) {
+          effects.push_back(effect);
+        }
+      }
+      if (not valid) {
+        fprintf(stderr, "%s:%zu: invalid %s\n", filename, lineNumber, keyword);
+        return false;
+      }
+    }
+    if (numPixels == 0 || duration == 0) {
+      fprintf(stderr, "%s: no pixels or duration\n", filename);
+      return false;
+    }
+
+    Clock::simulate(0);
+    Prng::seed(seed);
+    NeoPixelArray array(numPixels, 0, type, DebugMode::DryRun);
+    array.init();
+    for (size_t i = 0; i < effects.size(); ++i) {
+      switch (effects[i].type_) {
+        case 's': array.add(effects[i].snake_); break;
+        case 'p': array.add(effects[i].pulse_); break;
+        case 'r': array.add(effects[i].random_); break;
+      }
+    }
+    array.setFramePeriod(0); // a frame at every period
+
+    frames.numPixels_ = array.size();
+    frames.bytesPerPixel_ = array.bytesPerPixel();
+    const size_t numFrames = (duration * 1000 + period - 1) / period;
+    for (size_t frame = 0; frame < numFrames; ++frame) { // frame at frame * period
+      array.update();
+      frames.frames_.push_back(std::vector<uint8_t>(array.pixels(), array.pixels() + array.numBytes()));
+      Clock::advanceMicros(period);
+    }
+    Clock::release();
+    return true;
+  }
+
+  bool readRaw(const std::vector<uint8_t>& data, const Options& options, Frames& frames)
+  {
+    frames.numPixels_ = options.numPixels_;
+    frames.bytesPerPixel_ = options.bytesPerPixel_;
+    const size_t frameSize = frames.frameSize();
+    if (frameSize == 0 || data.size() % frameSize != 0) {
+      return false;
+    }
+    for (size_t offset = 0; offset < data.size(); offset += frameSize) {
+      frames.frames_.push_back(std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + frameSize));
+    }
+    return true;
+  }
+
+  void write(std::vector<uint8_t>& out, const uint8_t* data, size_t size)
+  {
+    out.insert(out.end(), data, data + size);
+  }
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  Options options;
+  if (not parse(argc, argv, options)) {
+    usage();
+  }
+
+  std::vector<uint8_t> data;
+  if (not readFile(options.input_, data)) {
+    fprintf(stderr, "cannot read %s\n", options.input_);
+    return 1;
+  }
+  Frames frames;
+  const bool raw = (options.numPixels_ != 0 || options.bytesPerPixel_ != 0);
+  if (options.script_) {
+    if (not readScript(data, options.input_, options.period_, frames)) {
+      return 1;
+    }
+  } else if (not (raw ? readRaw(data, options, frames) : readCapture(data, options.period_, frames))) {
+    fprintf(stderr, "%s: not a %s\n", options.input_, raw ? "sequence of raw frames" : "FrameRecorder capture");
+    return 1;
+  }
+  if (frames.numPixels_ > 0xFFFF || frames.frames_.empty()) {
+    fprintf(stderr, "%s: unsupported size\n", options.input_);
+    return 1;
+  }
+
+  FrameStream::Header header;
+  header.bytesPerPixel_ = frames.bytesPerPixel_;
+  header.numPixels_ = frames.numPixels_;
+  header.numFrames_ = frames.frames_.size();
+  header.framePeriod_ = options.period_;
+  header.audioTrack_ = options.audioTrack_;
+  const unsigned long keyInterval = (options.keyInterval_ != 0) ? options.keyInterval_ : 1000000 / options.period_;
+  header.keyFrameInterval_ = (keyInterval == 0) ? 1 : (keyInterval > 0xFFFF) ? 0xFFFF : keyInterval;
+
+  // frames, checked by decoding them as the player does
+  std::vector<uint8_t> out(FrameStream::HeaderSize);
+  std::vector<uint32_t> index;
+  std::vector<uint8_t> payload(FrameStream::maxPayloadSize(frames.numPixels_, frames.bytesPerPixel_));
+  std::vector<uint8_t> decoded(frames.frameSize());
+  std::vector<size_t> sizes; // per frame, with its size field
+  size_t maxPayloadSize = 0;
+  for (size_t i = 0; i < frames.frames_.size(); ++i) {
+    const bool key = (i % header.keyFrameInterval_ == 0);
+    if (key) {
+      index.push_back(out.size());
+    }
+    const size_t size = FrameStream::encode(frames.frames_[i].data(), key ? nullptr : frames.frames_[i - 1].data(),
+      frames.numPixels_, frames.bytesPerPixel_, payload.data());
+    if (size > 0xFFFF) {
+      fprintf(stderr, "frame %zu too large\n", i);
+      return 1;
+    }
+    if (not FrameStream::decode(payload.data(), size, decoded.data(), frames.numPixels_, frames.bytesPerPixel_)
+        || decoded != frames.frames_[i]) {
+      fprintf(stderr, "frame %zu does not decode back\n", i);
+      return 1;
+    }
+
+    uint8_t sizeField[2];
+    FrameStream::write16(sizeField, size);
+    write(out, sizeField, sizeof(sizeField));
+    write(out, payload.data(), size);
+    sizes.push_back(sizeof(sizeField) + size);
+    maxPayloadSize = (size > maxPayloadSize) ? size : maxPayloadSize;
+  }
+  header.maxPayloadSize_ = maxPayloadSize;
+  header.indexOffset_ = out.size();
+  for (size_t k = 0; k < index.size(); ++k) {
+    uint8_t offset[4];
+    FrameStream::write32(offset, index[k]);
+    write(out, offset, sizeof(offset));
+  }
+  header.write(out.data());
+
+  FILE* file = fopen(options.output_, "wb");
+  if (file == nullptr || fwrite(out.data(), 1, out.size(), file) != out.size() || fclose(file) != 0) {
+    fprintf(stderr, "cannot write %s\n", options.output_);
+    return 1;
+  }
+
+  // bandwidth: on average, and over the worst second of playback
+  const size_t framesPerSecond = (1000000 / options.period_ != 0) ? 1000000 / options.period_ : 1;
+  size_t window = 0;
+  size_t peak = 0;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    window += sizes[i];
+    if (i >= framesPerSecond) {
+      window -= sizes[i - framesPerSecond];
+    }
+    peak = (window > peak) ? window : peak;
+  }
+  const double duration = header.numFrames_ * options.period_ / 1e6; // s
+  const double rawSize = double(header.numFrames_) * frames.frameSize();
+  printf("frames:        %lu of %zu pixels x %zu bytes, %.2f s at %.1f fps\n",
+    (unsigned long)header.numFrames_, frames.numPixels_, frames.bytesPerPixel_, duration, 1e6 / options.period_);
+  printf("key frames:    every %u frames\n", header.keyFrameInterval_);
+  printf("size:          %zu bytes, %.1f%% of %.0f raw\n", out.size(), 100.0 * out.size() / rawSize, rawSize);
+  printf("largest frame: %zu bytes (player buffers: 2 x %zu)\n", maxPayloadSize + 2, maxPayloadSize);
+  printf("bandwidth:     %.2f kB/s average, %.2f kB/s peak second\n", out.size() / duration / 1000, peak / 1000.0);
+
+  if (options.budget_ > 0.0 && peak / 1000.0 > options.budget_) {
+    fprintf(stderr, "over budget: %.2f kB/s > %.2f kB/s\n", peak / 1000.0, options.budget_);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Golden frame regression check of the NeoPixel effects, on the host: the
+// scenarios of the nico_golden_frames sketch, with the golden files in a
+// directory of the host instead of the SD card. Exits with 1 if a frame
+// does not match.
+//
+// Results are printed as CSV lines:
+//   golden,scenario,frames,mismatches,max_difference,first_mismatch_frame,first_mismatch_offset
+//
+// Build on Linux, from this directory:
+//   g++ -O2 -I../../host -I../../nico -o nico_golden_frames nico_golden_frames.cpp
+//     ../../host/Arduino.cpp ../../nico/nico_frame.cpp ../../nico/nico_memory.cpp ../../nico/nico_neo_pixel.cpp
+//     ../../nico/nico_neo_pixel_blend.cpp ../../nico/nico_neo_pixel_map.cpp ../../nico/nico_neo_pixel_transport.cpp
+//     ../../nico/nico_neo_pixel_util.cpp ../../nico/nico_triple_buffer.cpp ../../nico/nico_util.cpp
+// Usage:
+//   nico_golden_frames [--record] [--tolerance n] directory
+//   --record         capture the golden files instead of comparing
+//   --tolerance n    largest accepted difference per byte, default 0
+
+#include "../../nico/examples/nico_golden_frames/golden_scenarios.h"
+
+#include <host_file.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool record = false;
+  unsigned long tolerance = 0;
+  const char* directory = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--record") {
+      record = true;
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = strtoul(argv[++i], nullptr, 10);
+    } else if (arg.compare(0, 2, "--") != 0 && directory == nullptr) {
+      directory = argv[i];
+    } else {
+      directory = nullptr;
+      break;
+    }
+  }
+  if (directory == nullptr || tolerance > 255) {
+    fprintf(stderr, "usage: nico_golden_frames [--record] [--tolerance n] directory\n");
+    return 2;
+  }
+
+  bool passed = true;
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+    const Scenario& scenario = scenarios[i];
+    const std::string filename = std::string(directory) + "/" + scenario.filename_;
+    HostFile file;
+    if (not file.open(filename.c_str(), record ? "wb" : "rb")) {
+      fprintf(stderr, "cannot open %s\n", filename.c_str());
+      passed = false;
+      continue;
+    }
+
+    if (record) {
+      FrameRecorder recorder(file);
+      renderScenario(scenario, &recorder, nullptr);
+      printf("recorded %s: %zu frames\n", filename.c_str(), recorder.numFrames());
+      continue;
+    }
+
+    FrameComparer comparer(file, tolerance);
+    if (not renderScenario(scenario, nullptr, &comparer)) {
+      fprintf(stderr, "%s: not a capture of this scenario\n", filename.c_str());
+      passed = false;
+      continue;
+    }
+    printf("golden,%s,%zu,%zu,%u,%zu,%zu\n", scenario.name_, comparer.numFrames(), comparer.numMismatches(),
+      (unsigned int)comparer.maxDifference(), comparer.firstMismatchFrame(), comparer.firstMismatchOffset());
+    passed = passed && comparer.numMismatches() == 0;
+  }
+  return passed ? 0 : 1;
+}
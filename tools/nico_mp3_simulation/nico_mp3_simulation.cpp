@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2024 Nicolas Hadacek
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+// MP3Player queueing and read-ahead with a simulated SD card and decoder, on
+// the host.
+//
+// The runs take no real time: the Clock is simulated, advanced by the main
+// loop period and the modeled SD latencies.
+// Results are printed as CSV lines, one per run:
+//   mp3sim,scenario,refill_period_ms,gaps,gap_time_us,underruns,sd_busy_us,trigger_latency_us
+// A run without gaps means the sound would be continuous.
+//
+// Build on Linux, from this directory:
+//   g++ -O2 -I../../host -I../../nico -I../../nico_mp3 -o nico_mp3_simulation nico_mp3_simulation.cpp
+//     ../../host/Arduino.cpp ../../nico/nico_memory.cpp ../../nico/nico_util.cpp
+//     ../../nico_mp3/nico_mp3.cpp ../../nico_mp3/nico_mp3_backend.cpp
+
+#include "nico_mp3.h"
+
+#include <stdio.h>
+
+#define SIM_BITRATE 128000 // bits/s
+#define SIM_TRACK_SIZE 65536UL // bytes, 4s at 128kbps
+#define SIM_DURATION 30000 // ms per run
+
+//-----------------------------------------------------------------------------
+static void report(const char* scenario, unsigned long period, const SimulatedDecoder& decoder,
+                   const MP3Player& player, const SimulatedStorage& storage)
+{
+  printf("mp3sim,%s,%lu,%lu,%lu,%lu,%lu,%lu\n", scenario, period,
+    decoder.gaps(), decoder.gapTime(), player.underruns(),
+    storage.busyTime(), player.triggerLatency());
+}
+
+// tracks back to back, with update() called every period ms
+static bool runQueue(unsigned long period, bool withClip)
+{
+  Clock::simulate(0);
+  SimulatedStorage storage;
+  SimulatedDecoder decoder(SIM_BITRATE);
+  for (uint16_t id = 1; id <= 3; ++id) {
+    storage.addTrack(id, SIM_TRACK_SIZE);
+  }
+  storage.addTrack(10, 4096, "CLIP.MP3");
+
+  MP3Player player(storage, decoder, DebugMode::None);
+  if (not player.init()) {
+    Clock::release();
+    return false;
+  }
+  const int clip = withClip ? player.preload("CLIP.MP3") : -1;
+  for (uint16_t id = 1; id <= 3; ++id) {
+    player.enqueueTrack(id);
+  }
+  player.setLoop(true);
+
+  const unsigned long start = Clock::millis();
+  bool triggered = false;
+  while (Clock::millis() - start < SIM_DURATION) {
+    player.update();
+    if (clip >= 0 && not triggered && Clock::millis() - start >= SIM_DURATION / 2) {
+      player.trigger(clip);
+      triggered = true;
+    }
+    Clock::advance(period);
+  }
+  report(withClip ? "queue_clip" : "queue", period, decoder, player, storage);
+  Clock::release();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+int main()
+{
+  Console::init();
+
+  bool ok = true;
+  const unsigned long periods[] = { 1, 10, 50, 100, 200, 400 };
+  for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); ++i) {
+    ok = runQueue(periods[i], false) && ok;
+  }
+  for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); ++i) {
+    ok = runQueue(periods[i], true) && ok;
+  }
+  return ok ? 0 : 1;
+}